@@ -0,0 +1,132 @@
+#pragma once
+
+/// Internal per-thread allocation counter shards, written by the allocation hooks and summed on read
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(MEMORYSTORM_ALLOC_TAGS)
+  #define MEMORYSTORM_ALLOC_LAYOUT tagged_layout
+#else
+  #define MEMORYSTORM_ALLOC_LAYOUT untagged_layout
+#endif // defined(MEMORYSTORM_ALLOC_TAGS)
+
+namespace memorystorm {
+namespace detail {
+
+uint32_t constexpr max_alloc_tags{64};
+
+inline namespace MEMORYSTORM_ALLOC_LAYOUT {                                     // the shard layout depends on MEMORYSTORM_ALLOC_TAGS, so a mix of settings fails to link
+
+struct alloc_tag_counters {
+  std::atomic<uint64_t> allocated_bytes{0};
+  std::atomic<uint64_t> freed_bytes{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> deallocations{0};
+  std::atomic<uint64_t> max_live_bytes{0};                                      // highest allocated minus freed in this shard
+};
+
+struct alignas(64) alloc_shard {
+  /// Counters owned by one thread at a time, on their own cache line; the owner writes with plain relaxed stores
+  std::atomic<uint64_t> allocated_bytes{0};
+  std::atomic<uint64_t> freed_bytes{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> deallocations{0};
+  std::atomic<bool> in_use{false};
+  #if defined(MEMORYSTORM_ALLOC_TAGS)
+  alloc_tag_counters tags[max_alloc_tags]{};                                    // per scope_tag breakdown
+  #endif // defined(MEMORYSTORM_ALLOC_TAGS)
+  alloc_shard *next{nullptr};                                                   // registry link, never changes once published
+};
+
+extern std::atomic<alloc_shard*> alloc_shards;                                  // head of the registry of every shard ever created
+extern alloc_shard orphan_alloc_shard;                                          // shared fallback for allocations during thread teardown
+extern std::atomic<bool> alloc_hooks_active;
+
+alloc_shard *acquire_alloc_shard();
+void release_alloc_shard(alloc_shard *shard);
+
+}
+
+extern std::atomic<uint64_t> heap_profile_period;                               // mean bytes between heap profile samples, zero when not profiling
+extern std::atomic<uint64_t> heap_profile_live_samples;
+
+extern std::atomic<uint32_t> peak_tracking;                                     // number of peak_scopes measuring the heap, zero otherwise
+extern std::atomic<int64_t> peak_live_bytes;                                    // bytes allocated minus freed while tracking, from an arbitrary origin
+extern std::atomic<int64_t> peak_live_max;                                      // highest peak_live_bytes since the last scope began
+
+int64_t next_heap_sample_interval(uint64_t period);
+void record_heap_sample(void *pointer, size_t size);
+void forget_heap_sample(void *pointer);
+
+inline void owner_add(std::atomic<uint64_t> &counter, uint64_t amount) {
+  /// Increment a counter only ever written by its owning thread, avoiding a locked read-modify-write
+  counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void record_allocation(alloc_shard *shard, size_t size) {
+  /// Count one allocation against the calling thread's shard
+  if(shard == &orphan_alloc_shard) {
+    shard->allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    shard->allocations.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  owner_add(shard->allocated_bytes, size);
+  owner_add(shard->allocations, 1);
+}
+
+inline void record_deallocation(alloc_shard *shard, size_t size) {
+  /// Count one deallocation against the calling thread's shard
+  if(shard == &orphan_alloc_shard) {
+    shard->freed_bytes.fetch_add(size, std::memory_order_relaxed);
+    shard->deallocations.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  owner_add(shard->freed_bytes, size);
+  owner_add(shard->deallocations, 1);
+}
+
+inline void record_peak(int64_t delta) {
+  /// A shared counter and running maximum, too costly to keep up all the time, so only while a peak_scope needs them
+  int64_t const live{peak_live_bytes.fetch_add(delta, std::memory_order_relaxed) + delta};
+  int64_t max{peak_live_max.load(std::memory_order_relaxed)};
+  while(live > max && !peak_live_max.compare_exchange_weak(max, live, std::memory_order_relaxed)) {}
+}
+
+#if defined(MEMORYSTORM_ALLOC_TAGS)
+inline void record_tagged(alloc_shard *shard, uint32_t tag, std::atomic<uint64_t> alloc_tag_counters::*bytes, std::atomic<uint64_t> alloc_tag_counters::*count, size_t size) {
+  /// Count against one scope tag's counters in the calling thread's shard
+  alloc_tag_counters &counters{shard->tags[tag < max_alloc_tags ? tag : 0]};
+  if(shard == &orphan_alloc_shard) {
+    (counters.*bytes).fetch_add(size, std::memory_order_relaxed);
+    (counters.*count).fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  owner_add(counters.*bytes, size);
+  owner_add(counters.*count, 1);
+}
+
+inline void record_tagged_allocation(alloc_shard *shard, uint32_t tag, size_t size) {
+  /// Count an allocation against its tag, and raise this shard's running maximum for the tag; nothing here is shared between threads
+  record_tagged(shard, tag, &alloc_tag_counters::allocated_bytes, &alloc_tag_counters::allocations, size);
+  alloc_tag_counters &counters{shard->tags[tag < max_alloc_tags ? tag : 0]};
+  uint64_t const allocated{counters.allocated_bytes.load(std::memory_order_relaxed)};
+  uint64_t const freed{counters.freed_bytes.load(std::memory_order_relaxed)};
+  uint64_t const live{allocated > freed ? allocated - freed : 0};
+  uint64_t max{counters.max_live_bytes.load(std::memory_order_relaxed)};
+  if(shard == &orphan_alloc_shard) {
+    while(live > max && !counters.max_live_bytes.compare_exchange_weak(max, live, std::memory_order_relaxed)) {}
+  } else if(live > max) {
+    counters.max_live_bytes.store(live, std::memory_order_relaxed);
+  }
+}
+
+inline void record_tagged_deallocation(alloc_shard *shard, uint32_t tag, size_t size) {
+  /// Count a free against the tag that allocated the block
+  record_tagged(shard, tag, &alloc_tag_counters::freed_bytes, &alloc_tag_counters::deallocations, size);
+}
+#endif // defined(MEMORYSTORM_ALLOC_TAGS)
+
+}
+}
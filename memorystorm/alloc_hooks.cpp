@@ -0,0 +1,262 @@
+/// Optional replacement of the global operator new and delete that counts allocations for get_alloc_stats()
+/// Compile this file into your program (not a shared library) to enable allocation accounting.
+/// Define MEMORYSTORM_ALLOC_TAGS for it and the rest of memorystorm to also attribute allocations to scope tags.
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "alloc_counters.h"
+#include "platform_defines.h"
+#include "scope_tag.h"
+#if defined(PLATFORM_WINDOWS)
+  #include <malloc.h>
+#elif defined(PLATFORM_MACOS)
+  #include <malloc/malloc.h>
+#else
+  #include <malloc.h>
+#endif // platform selection
+
+namespace memorystorm {
+
+namespace {
+
+thread_local detail::alloc_shard *thread_shard{nullptr};                        // trivially initialised, so access is a plain TLS load
+thread_local bool thread_exited{false};
+thread_local int64_t bytes_until_sample{0};                                     // heap profiler countdown, so unsampled allocations cost one subtraction
+thread_local bool in_heap_profiler{false};
+
+int64_t constexpr profiler_recheck_bytes{64 * 1024};                           // while not profiling, how often to check whether profiling has started
+
+#if defined(MEMORYSTORM_ALLOC_TAGS)
+size_t constexpr tag_header_size{alignof(std::max_align_t)};                  // room in front of each block to record the tag that allocated it
+#else
+size_t constexpr tag_header_size{0};
+#endif // defined(MEMORYSTORM_ALLOC_TAGS)
+
+struct shard_releaser {
+  /// Returns the thread's shard to the registry when the thread exits
+  ~shard_releaser() {
+    detail::release_alloc_shard(thread_shard);
+    thread_shard = &detail::orphan_alloc_shard;                                 // anything freed later in teardown is still counted
+    thread_exited = true;
+  }
+};
+
+detail::alloc_shard *get_thread_shard_slow() {
+  /// First allocation on this thread: claim a shard and arrange for its release
+  if(thread_exited) {
+    return &detail::orphan_alloc_shard;
+  }
+  thread_shard = detail::acquire_alloc_shard();
+  static thread_local shard_releaser releaser;
+  (void)releaser;
+  return thread_shard;
+}
+
+inline detail::alloc_shard *get_thread_shard() {
+  detail::alloc_shard *const shard{thread_shard};
+  return shard ? shard : get_thread_shard_slow();
+}
+
+void sample_allocation_slow(void *pointer, size_t size) {
+  /// Countdown expired: record a heap profile sample if profiling, and draw the next interval
+  uint64_t const period{detail::heap_profile_period.load(std::memory_order_relaxed)};
+  if(period == 0) {
+    bytes_until_sample = profiler_recheck_bytes;
+    return;
+  }
+  if(in_heap_profiler) {
+    return;                                                                     // don't sample the profiler's own allocations
+  }
+  in_heap_profiler = true;
+  detail::record_heap_sample(pointer, size);
+  bytes_until_sample = detail::next_heap_sample_interval(period);
+  in_heap_profiler = false;
+}
+
+inline void sample_allocation(void *pointer, size_t size) {
+  bytes_until_sample -= static_cast<int64_t>(size);
+  if(bytes_until_sample < 0) {
+    sample_allocation_slow(pointer, size);
+  }
+}
+
+inline void forget_sample(void *pointer) {
+  /// Must happen before the memory is released, in case another thread reuses the address straight away
+  if(detail::heap_profile_live_samples.load(std::memory_order_relaxed) != 0) {
+    detail::forget_heap_sample(pointer);
+  }
+}
+
+inline size_t usable_size(void *pointer) {
+  /// Size the allocator actually reserved, used for both allocation and deallocation so they always balance
+  #if defined(PLATFORM_WINDOWS)
+    return _msize(pointer);
+  #elif defined(PLATFORM_MACOS)
+    return malloc_size(pointer);
+  #else
+    return malloc_usable_size(pointer);
+  #endif // platform selection
+}
+
+#if defined(PLATFORM_WINDOWS)
+inline size_t usable_size_aligned(void *pointer, size_t align) {
+  return _aligned_msize(pointer, align, 0);
+}
+#else
+inline size_t usable_size_aligned(void *pointer, size_t) {
+  return usable_size(pointer);
+}
+#endif // defined(PLATFORM_WINDOWS)
+
+inline size_t get_alignment(std::align_val_t alignment) {
+  size_t const align{static_cast<size_t>(alignment)};
+  return align < sizeof(void*) ? sizeof(void*) : align;
+}
+
+inline size_t get_header_size(size_t align) {
+  /// The tag header must be a multiple of the alignment so the caller's pointer stays aligned
+  return tag_header_size == 0 || align <= tag_header_size ? tag_header_size : align;
+}
+
+inline void *finish_allocation(void *block, size_t header, size_t allocated) {
+  /// Count a new block and hand back the caller's pointer, past the tag header if there is one
+  detail::alloc_shard *const shard{get_thread_shard()};
+  detail::record_allocation(shard, allocated);
+  if(detail::peak_tracking.load(std::memory_order_relaxed) != 0) {
+    detail::record_peak(static_cast<int64_t>(allocated));
+  }
+  void *const pointer{static_cast<char*>(block) + header};
+  #if defined(MEMORYSTORM_ALLOC_TAGS)
+    uint32_t const tag{detail::current_alloc_tag};
+    std::memcpy(static_cast<char*>(pointer) - sizeof(tag), &tag, sizeof(tag));
+    detail::record_tagged_allocation(shard, tag, allocated);
+  #endif // defined(MEMORYSTORM_ALLOC_TAGS)
+  sample_allocation(pointer, allocated);
+  return pointer;
+}
+
+inline void release_block(void *pointer, size_t allocated) {
+  /// Count a freed block against the tag that allocated it, whichever tag is current now
+  detail::alloc_shard *const shard{get_thread_shard()};
+  detail::record_deallocation(shard, allocated);
+  if(detail::peak_tracking.load(std::memory_order_relaxed) != 0) {
+    detail::record_peak(-static_cast<int64_t>(allocated));
+  }
+  #if defined(MEMORYSTORM_ALLOC_TAGS)
+    uint32_t tag;
+    std::memcpy(&tag, static_cast<char*>(pointer) - sizeof(tag), sizeof(tag));
+    detail::record_tagged_deallocation(shard, tag, allocated);
+  #endif // defined(MEMORYSTORM_ALLOC_TAGS)
+  forget_sample(pointer);
+}
+
+void *allocate(size_t size) {
+  /// malloc with the standard new_handler retry loop
+  if(size == 0) {
+    size = 1;
+  }
+  while(true) {
+    if(void *const block{std::malloc(size + tag_header_size)}) {
+      return finish_allocation(block, tag_header_size, usable_size(block));
+    }
+    std::new_handler const handler{std::get_new_handler()};
+    if(!handler) {
+      throw std::bad_alloc{};
+    }
+    handler();
+  }
+}
+
+void *allocate_aligned(size_t size, std::align_val_t alignment) {
+  /// Aligned allocation with the standard new_handler retry loop
+  if(size == 0) {
+    size = 1;
+  }
+  size_t const align{get_alignment(alignment)};
+  size_t const header{get_header_size(align)};
+  while(true) {
+    void *block{nullptr};
+    #if defined(PLATFORM_WINDOWS)
+      block = _aligned_malloc(size + header, align);
+    #else
+      if(posix_memalign(&block, align, size + header) != 0) {
+        block = nullptr;
+      }
+    #endif // defined(PLATFORM_WINDOWS)
+    if(block) {
+      return finish_allocation(block, header, usable_size_aligned(block, align));
+    }
+    std::new_handler const handler{std::get_new_handler()};
+    if(!handler) {
+      throw std::bad_alloc{};
+    }
+    handler();
+  }
+}
+
+template<typename Function>
+void *allocate_nothrow(Function &&function) noexcept {
+  /// The nothrow forms still call the new_handler, which may throw
+  try {
+    return function();
+  } catch(...) {
+    return nullptr;
+  }
+}
+
+void deallocate(void *pointer) noexcept {
+  if(!pointer) {
+    return;
+  }
+  void *const block{static_cast<char*>(pointer) - tag_header_size};
+  release_block(pointer, usable_size(block));
+  std::free(block);
+}
+
+void deallocate_aligned(void *pointer, std::align_val_t alignment) noexcept {
+  if(!pointer) {
+    return;
+  }
+  size_t const align{get_alignment(alignment)};
+  void *const block{static_cast<char*>(pointer) - get_header_size(align)};
+  release_block(pointer, usable_size_aligned(block, align));
+  #if defined(PLATFORM_WINDOWS)
+    _aligned_free(block);
+  #else
+    std::free(block);
+  #endif // defined(PLATFORM_WINDOWS)
+}
+
+struct hooks_marker {
+  hooks_marker() {
+    detail::alloc_hooks_active.store(true, std::memory_order_relaxed);
+  }
+} const marker;
+
+}
+
+}
+
+void *operator new(size_t size)                                                      {return memorystorm::allocate(size);}
+void *operator new[](size_t size)                                                    {return memorystorm::allocate(size);}
+void *operator new(size_t size, std::nothrow_t const&) noexcept                      {return memorystorm::allocate_nothrow([&]{return memorystorm::allocate(size);});}
+void *operator new[](size_t size, std::nothrow_t const&) noexcept                    {return memorystorm::allocate_nothrow([&]{return memorystorm::allocate(size);});}
+void *operator new(size_t size, std::align_val_t alignment)                          {return memorystorm::allocate_aligned(size, alignment);}
+void *operator new[](size_t size, std::align_val_t alignment)                        {return memorystorm::allocate_aligned(size, alignment);}
+void *operator new(size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept   {return memorystorm::allocate_nothrow([&]{return memorystorm::allocate_aligned(size, alignment);});}
+void *operator new[](size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept {return memorystorm::allocate_nothrow([&]{return memorystorm::allocate_aligned(size, alignment);});}
+
+void operator delete(void *pointer) noexcept                                         {memorystorm::deallocate(pointer);}
+void operator delete[](void *pointer) noexcept                                       {memorystorm::deallocate(pointer);}
+void operator delete(void *pointer, std::nothrow_t const&) noexcept                  {memorystorm::deallocate(pointer);}
+void operator delete[](void *pointer, std::nothrow_t const&) noexcept                {memorystorm::deallocate(pointer);}
+void operator delete(void *pointer, size_t) noexcept                                 {memorystorm::deallocate(pointer);}
+void operator delete[](void *pointer, size_t) noexcept                               {memorystorm::deallocate(pointer);}
+void operator delete(void *pointer, std::align_val_t alignment) noexcept             {memorystorm::deallocate_aligned(pointer, alignment);}
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept           {memorystorm::deallocate_aligned(pointer, alignment);}
+void operator delete(void *pointer, size_t, std::align_val_t alignment) noexcept     {memorystorm::deallocate_aligned(pointer, alignment);}
+void operator delete[](void *pointer, size_t, std::align_val_t alignment) noexcept   {memorystorm::deallocate_aligned(pointer, alignment);}
+void operator delete(void *pointer, std::align_val_t alignment, std::nothrow_t const&) noexcept   {memorystorm::deallocate_aligned(pointer, alignment);}
+void operator delete[](void *pointer, std::align_val_t alignment, std::nothrow_t const&) noexcept {memorystorm::deallocate_aligned(pointer, alignment);}
@@ -0,0 +1,114 @@
+#include "arena.h"
+#include <limits>
+#include <new>
+
+namespace memorystorm {
+
+arena::arena(std::string this_name,
+             uint64_t this_budget,
+             size_t this_block_size,
+             std::pmr::memory_resource *this_upstream)
+  : tracked_resource{std::move(this_name), this_budget},
+    upstream{this_upstream},
+    block_size{this_block_size} {
+}
+
+arena::~arena() {
+  release();
+}
+
+void arena::use_block(block *target) {
+  /// Make a block the one being bumped through, starting from its beginning
+  current = target;
+  cursor = reinterpret_cast<char*>(target) + sizeof(block);
+  limit = reinterpret_cast<char*>(target) + target->size;
+}
+
+void *arena::allocate_slow(size_t bytes, size_t alignment) {
+  /// The current block is full: move on to a block kept from before the last reset, or get a new one from upstream
+  auto const try_bump{[&]() -> void* {
+    uintptr_t const address{(reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t{alignment} - 1)};
+    uintptr_t const end{reinterpret_cast<uintptr_t>(limit)};
+    if(address > end || bytes > end - address) {
+      return nullptr;
+    }
+    cursor = reinterpret_cast<char*>(address + bytes);
+    add_used(bytes);
+    return reinterpret_cast<void*>(address);
+  }};
+  while(current && current->next) {
+    use_block(current->next);
+    if(void *const pointer{try_bump()}) {
+      return pointer;
+    }
+  }
+
+  if(bytes > std::numeric_limits<size_t>::max() - sizeof(block) - alignment) {
+    throw std::bad_alloc{};
+  }
+  size_t const needed{sizeof(block) + bytes + alignment};
+  size_t size{needed > block_size ? needed : block_size};
+  if(!try_reserve(size)) {
+    if(size == needed || !try_reserve(needed)) {                                // a full block would exceed the budget, but this allocation alone might not
+      throw std::bad_alloc{};
+    }
+    size = needed;
+  }
+  void *memory{nullptr};
+  try {
+    memory = upstream->allocate(size, alignof(std::max_align_t));
+  } catch(...) {
+    unreserve(size);
+    throw;
+  }
+  block *const fresh{new(memory) block{nullptr, size}};
+  if(current) {
+    fresh->next = current->next;
+    current->next = fresh;
+  } else {
+    first = fresh;
+  }
+  use_block(fresh);
+  if(void *const pointer{try_bump()}) {
+    return pointer;
+  }
+  throw std::bad_alloc{};                                                       // needed leaves room for any padding, so only a misaligned upstream block gets here
+}
+
+void arena::do_deallocate(void *pointer, size_t bytes, size_t alignment) {
+  /// Individual frees are ignored; memory is reclaimed all at once by reset() or release()
+  (void)pointer;
+  (void)bytes;
+  (void)alignment;
+}
+
+bool arena::do_is_equal(std::pmr::memory_resource const &other) const noexcept {
+  return this == &other;
+}
+
+void arena::reset() {
+  /// Discard everything allocated, keeping the blocks for reuse; outstanding pointers become invalid
+  clear_used();
+  if(first) {
+    use_block(first);
+  }
+}
+
+void arena::release() {
+  /// Discard everything allocated and return all blocks upstream
+  block *it{first};
+  while(it) {
+    block *const next{it->next};
+    size_t const size{it->size};
+    upstream->deallocate(it, size, alignof(std::max_align_t));
+    unreserve(size);
+    it = next;
+  }
+  first = nullptr;
+  current = nullptr;
+  cursor = nullptr;
+  limit = nullptr;
+  clear_used();
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+/// Bump allocator with bulk reset, for short-lived per-frame or per-request allocations
+
+#include <cstddef>
+#include "resource.h"
+
+namespace memorystorm {
+
+class arena : public tracked_resource {
+  /// Not thread safe, like std::pmr::monotonic_buffer_resource; deallocation is a no-op until reset()
+  struct block {
+    block *next;
+    size_t size;                                                                // total bytes obtained from upstream, including this header
+  };
+
+  std::pmr::memory_resource *const upstream;
+  size_t const block_size;
+  block *first{nullptr};
+  block *current{nullptr};
+  char *cursor{nullptr};
+  char *limit{nullptr};
+
+  void *allocate_slow(size_t bytes, size_t alignment);
+  void use_block(block *target);
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+  bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override;
+
+public:
+  static size_t constexpr default_block_size{64 * 1024};
+
+  explicit arena(std::string name,
+                 uint64_t budget = unlimited,
+                 size_t block_size = default_block_size,
+                 std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
+  ~arena() override;
+
+  void reset();
+  void release();
+};
+
+inline void *arena::do_allocate(size_t bytes, size_t alignment) {
+  /// Fast path: bump the cursor within the current block
+  uintptr_t const address{(reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(uintptr_t{alignment} - 1)};
+  uintptr_t const end{reinterpret_cast<uintptr_t>(limit)};
+  if(cursor && address <= end && bytes <= end - address) {                      // written to not overflow on huge requests
+    cursor = reinterpret_cast<char*>(address + bytes);
+    add_used(bytes);
+    return reinterpret_cast<void*>(address);
+  }
+  return allocate_slow(bytes, alignment);
+}
+
+}
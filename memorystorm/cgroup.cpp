@@ -0,0 +1,428 @@
+#include "cgroup.h"
+#include <algorithm>
+#include "platform_defines.h"
+#if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  #include <fstream>
+  #include <sstream>
+  #include <string_view>
+  #include <vector>
+  #include "procfs.h"
+  #define MEMORYSTORM_CGROUP_SUPPORTED
+#endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+
+namespace memorystorm {
+
+namespace {
+
+#if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+struct cgroup_mount {
+  std::string root;
+  std::string point;
+};
+
+bool contains_word(std::string_view list, std::string_view word, char separator) {
+  /// Check whether a separator-delimited list contains a given entry
+  while(!list.empty()) {
+    auto const end{list.find(separator)};
+    if(list.substr(0, end) == word) {
+      return true;
+    }
+    if(end == std::string_view::npos) {
+      break;
+    }
+    list.remove_prefix(end + 1);
+  }
+  return false;
+}
+
+template<typename Callback>
+void for_each_text_line(std::string_view text, Callback &&callback) {
+  /// Call back with each line of a file already read into memory
+  while(!text.empty()) {
+    auto const end{text.find('\n')};
+    callback(text.substr(0, end));
+    if(end == std::string_view::npos) {
+      break;
+    }
+    text.remove_prefix(end + 1);
+  }
+}
+
+std::string read_text(char const *path) {
+  /// Read a whole small file, or nothing if it can't be opened
+  std::ifstream file{path};
+  std::ostringstream ss;
+  ss << file.rdbuf();
+  return ss.str();
+}
+
+bool read_cgroup_value(int dirfd, char const *name, uint64_t &value) {
+  /// Read a single-value cgroup file, mapping "max" and v1's near-LONG_MAX sentinel to unlimited
+  char buffer[64];
+  size_t const length{procfs::read_file(dirfd, name, buffer, sizeof(buffer))};
+  if(length == 0) {
+    return false;
+  }
+  if(std::string_view{buffer, length}.compare(0, 3, "max") == 0) {
+    value = unlimited;
+    return true;
+  }
+  procfs::parse_uint(buffer, buffer + length, value);
+  if(value >= uint64_t{1} << 62) {
+    value = unlimited;
+  }
+  return true;
+}
+
+struct cgroup_state {
+  /// This process's memory cgroup, resolved once
+  detail::cgroup_location location;
+  detail::cgroup_directories directories;
+
+  explicit cgroup_state(detail::cgroup_location this_location)
+    : location{std::move(this_location)},
+      directories{location} {
+  }
+};
+
+detail::cgroup_location detect_cgroup() {
+  /// Find this process's memory cgroup from the live procfs files
+  return detail::find_cgroup(read_text("/proc/self/cgroup"), read_text("/proc/self/mountinfo"), [](std::string const &path){
+    std::ifstream file{path};
+    std::string line;
+    std::getline(file, line);
+    return line;
+  });
+}
+
+cgroup_state const &get_state() {
+  /// Detected once and cached, so repeated queries only read the value files themselves
+  static cgroup_state const state{detect_cgroup()};
+  return state;
+}
+
+cgroup_state const &startup_state{get_state()};                                 // resolve the path at startup rather than on the first query
+
+uint64_t read_hierarchical_limit(char const *name) {
+  return get_state().directories.read_limit(name);
+}
+
+uint64_t read_own_value(char const *name) {
+  return get_state().directories.read_value(name);
+}
+
+struct stat_key {
+  std::string_view key;
+  uint64_t cgroup_memory_stat::*member;
+};
+
+stat_key constexpr stat_keys_v2[]{
+  {"anon",               &cgroup_memory_stat::anon},
+  {"file",               &cgroup_memory_stat::file},
+  {"kernel_stack",       &cgroup_memory_stat::kernel_stack},
+  {"pagetables",         &cgroup_memory_stat::pagetables},
+  {"shmem",              &cgroup_memory_stat::shmem},
+  {"file_mapped",        &cgroup_memory_stat::file_mapped},
+  {"file_dirty",         &cgroup_memory_stat::file_dirty},
+  {"file_writeback",     &cgroup_memory_stat::file_writeback},
+  {"active_anon",        &cgroup_memory_stat::active_anon},
+  {"inactive_anon",      &cgroup_memory_stat::inactive_anon},
+  {"active_file",        &cgroup_memory_stat::active_file},
+  {"inactive_file",      &cgroup_memory_stat::inactive_file},
+  {"unevictable",        &cgroup_memory_stat::unevictable},
+  {"slab_reclaimable",   &cgroup_memory_stat::slab_reclaimable},
+  {"slab_unreclaimable", &cgroup_memory_stat::slab_unreclaimable},
+};
+stat_key constexpr stat_keys_v1[]{                                              // hierarchical totals, to match v2 semantics
+  {"total_rss",           &cgroup_memory_stat::anon},
+  {"total_cache",         &cgroup_memory_stat::file},
+  {"total_shmem",         &cgroup_memory_stat::shmem},
+  {"total_mapped_file",   &cgroup_memory_stat::file_mapped},
+  {"total_dirty",         &cgroup_memory_stat::file_dirty},
+  {"total_writeback",     &cgroup_memory_stat::file_writeback},
+  {"total_swap",          &cgroup_memory_stat::swap},
+  {"total_active_anon",   &cgroup_memory_stat::active_anon},
+  {"total_inactive_anon", &cgroup_memory_stat::inactive_anon},
+  {"total_active_file",   &cgroup_memory_stat::active_file},
+  {"total_inactive_file", &cgroup_memory_stat::inactive_file},
+  {"total_unevictable",   &cgroup_memory_stat::unevictable},
+};
+#endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+
+}
+
+namespace detail {
+
+cgroup_location find_cgroup(std::string_view cgroup_file,
+                            std::string_view mountinfo_file,
+                            std::function<std::string(std::string const &path)> const &read_first_line) {
+  /// Resolve the memory cgroup from the contents of /proc/self/cgroup and /proc/self/mountinfo, preferring v2
+  cgroup_location result;
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    std::string v2_path;
+    std::string v1_path;
+    bool has_v2{false};
+    bool has_v1{false};
+    for_each_text_line(cgroup_file, [&](std::string_view line){                 // format: hierarchy-id:controller-list:path
+      auto const first{line.find(':')};
+      auto const second{line.find(':', first + 1)};
+      if(first == std::string_view::npos || second == std::string_view::npos) {
+        return;
+      }
+      std::string_view const controllers{line.substr(first + 1, second - first - 1)};
+      if(line.substr(0, first) == "0" && controllers.empty()) {
+        v2_path = line.substr(second + 1);
+        has_v2 = true;
+      } else if(contains_word(controllers, "memory", ',')) {
+        v1_path = line.substr(second + 1);
+        has_v1 = true;
+      }
+    });
+    cgroup_mount v2_mount;
+    cgroup_mount v1_mount;
+    for_each_text_line(mountinfo_file, [&](std::string_view line){              // format: id parent major:minor root point options [optional...] - fstype source super-options
+      std::istringstream ss{std::string{line}};
+      std::string id, parent, device, root, point, options, field;
+      ss >> id >> parent >> device >> root >> point >> options;
+      while(ss >> field && field != "-") {}
+      std::string fstype, source, super_options;
+      ss >> fstype >> source >> super_options;
+      if(fstype == "cgroup2" && v2_mount.point.empty()) {
+        v2_mount = {root, point};
+      } else if(fstype == "cgroup" && v1_mount.point.empty() && contains_word(super_options, "memory", ',')) {
+        v1_mount = {root, point};
+      }
+    });
+
+    cgroup_mount mount;
+    std::string relative;
+    if(has_v2 && !v2_mount.point.empty() && contains_word(read_first_line(v2_mount.point + "/cgroup.controllers"), "memory", ' ')) { // in hybrid setups the memory controller may still be on v1
+      result.version = cgroup_version::v2;
+      mount = v2_mount;
+      relative = v2_path;
+    } else if(has_v1 && !v1_mount.point.empty()) {
+      result.version = cgroup_version::v1;
+      mount = v1_mount;
+      relative = v1_path;
+    } else {
+      return result;
+    }
+    if(mount.root != "/" && relative.compare(0, mount.root.size(), mount.root) == 0) {
+      relative.erase(0, mount.root.size());                                     // the mount exposes only a subtree, as inside a container
+    }
+    while(relative.size() > 1 && relative.back() == '/') {
+      relative.pop_back();
+    }
+    result.path = relative.empty() || relative == "/" ? mount.point : mount.point + relative;
+    result.mount_point = mount.point;
+  #else
+    (void)cgroup_file;
+    (void)mountinfo_file;
+    (void)read_first_line;
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return result;
+}
+
+cgroup_directories::cgroup_directories(cgroup_location const &location) {
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    if(location.version == cgroup_version::none) {
+      return;
+    }
+    std::string current{location.path};
+    while(true) {
+      int const fd{open(current.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+      if(fd >= 0) {
+        if(current == location.path) {
+          own = fd;
+        }
+        chain.emplace_back(fd);
+      }
+      if(current.size() <= location.mount_point.size()) {
+        break;
+      }
+      current.erase(current.rfind('/'));
+    }
+  #else
+    (void)location;
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+}
+
+cgroup_directories::~cgroup_directories() {
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    for(int const fd : chain) {
+      close(fd);
+    }
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+}
+
+int cgroup_directories::get_own() const {
+  /// The cgroup's own directory, or -1 if it couldn't be opened
+  return own;
+}
+
+uint64_t cgroup_directories::read_limit(char const *name) const {
+  /// The tightest limit set on this cgroup or any of its ancestors
+  uint64_t result{unlimited};
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    for(int const dirfd : chain) {
+      uint64_t value{unlimited};
+      if(read_cgroup_value(dirfd, name, value)) {
+        result = std::min(result, value);
+      }
+    }
+  #else
+    (void)name;
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return result;
+}
+
+uint64_t cgroup_directories::read_value(char const *name) const {
+  /// A value from the cgroup's own directory, or zero if unavailable; never an ancestor's value
+  uint64_t value{0};
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    if(own >= 0) {
+      read_cgroup_value(own, name, value);
+    }
+  #else
+    (void)name;
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return value;
+}
+
+}
+
+cgroup_version get_cgroup_version() {
+  /// Which cgroup hierarchy the memory controller was found on, if any
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    return get_state().location.version;
+  #else
+    return cgroup_version::none;
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+}
+
+std::string const &get_cgroup_path() {
+  /// Filesystem path of this process's memory cgroup, or empty if none was found
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    return get_state().location.path;
+  #else
+    static std::string const empty;
+    return empty;
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+}
+
+uint64_t get_cgroup_memory_max() {
+  /// Hard memory limit (memory.max, or v1 memory.limit_in_bytes), including limits set on ancestors
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    switch(get_state().location.version) {
+    case cgroup_version::v2:
+      return read_hierarchical_limit("memory.max");
+    case cgroup_version::v1:
+      return read_hierarchical_limit("memory.limit_in_bytes");
+    default:
+      break;
+    }
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return unlimited;
+}
+
+uint64_t get_cgroup_memory_high() {
+  /// Throttling threshold (memory.high, or v1 memory.soft_limit_in_bytes), including limits set on ancestors
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    switch(get_state().location.version) {
+    case cgroup_version::v2:
+      return read_hierarchical_limit("memory.high");
+    case cgroup_version::v1:
+      return read_hierarchical_limit("memory.soft_limit_in_bytes");
+    default:
+      break;
+    }
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return unlimited;
+}
+
+uint64_t get_cgroup_memory_current() {
+  /// Memory currently charged to this cgroup, including page cache
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    switch(get_state().location.version) {
+    case cgroup_version::v2:
+      return read_own_value("memory.current");
+    case cgroup_version::v1:
+      return read_own_value("memory.usage_in_bytes");
+    default:
+      break;
+    }
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return 0;
+}
+
+uint64_t get_cgroup_swap_max() {
+  /// Swap limit (memory.swap.max, or the difference between v1's memsw and memory limits)
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    switch(get_state().location.version) {
+    case cgroup_version::v2:
+      return read_hierarchical_limit("memory.swap.max");
+    case cgroup_version::v1: {
+      uint64_t const combined{read_hierarchical_limit("memory.memsw.limit_in_bytes")};
+      uint64_t const memory{read_hierarchical_limit("memory.limit_in_bytes")};
+      if(combined == unlimited) {
+        return unlimited;
+      }
+      return combined > memory ? combined - memory : 0;
+    }
+    default:
+      break;
+    }
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return unlimited;
+}
+
+cgroup_memory_stat get_cgroup_memory_stat() {
+  /// Parse the memory.stat breakdown for this process's cgroup
+  cgroup_memory_stat result{};
+  #if defined(MEMORYSTORM_CGROUP_SUPPORTED)
+    auto const &state{get_state()};
+    int const own{state.directories.get_own()};
+    if(own < 0) {
+      return result;
+    }
+    char buffer[8192];
+    size_t const length{procfs::read_file(own, "memory.stat", buffer, sizeof(buffer))};
+    auto const parse{[&](auto const &keys){
+      procfs::for_each_key_value(buffer, buffer + length, [&](std::string_view key, uint64_t value){
+        for(auto const &entry : keys) {
+          if(entry.key == key) {
+            result.*entry.member = value;
+            return;
+          }
+        }
+      });
+    }};
+    if(state.location.version == cgroup_version::v2) {
+      parse(stat_keys_v2);
+      result.swap = read_own_value("memory.swap.current");
+    } else {
+      parse(stat_keys_v1);
+    }
+  #endif // defined(MEMORYSTORM_CGROUP_SUPPORTED)
+  return result;
+}
+
+uint64_t get_effective_physical_total() {
+  /// Physical memory this process can actually use: the smaller of the host's memory and the cgroup limit
+  return std::min(get_physical_total(), get_cgroup_memory_max());
+}
+
+uint64_t get_effective_physical_available() {
+  /// Available memory within both the host and the cgroup limit
+  uint64_t const host{get_physical_available()};
+  uint64_t const limit{get_cgroup_memory_max()};
+  if(limit == unlimited) {
+    return host;
+  }
+  uint64_t const current{get_cgroup_memory_current()};
+  uint64_t const reclaimable{get_cgroup_memory_stat().inactive_file};           // inactive page cache is reclaimed before the cgroup is OOM-killed
+  uint64_t const working_set{current > reclaimable ? current - reclaimable : 0};
+  return std::min(host, limit > working_set ? limit - working_set : 0);
+}
+
+}
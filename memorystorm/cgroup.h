@@ -0,0 +1,81 @@
+#pragma once
+
+/// Container-aware memory limits and usage from Linux control groups (v2, with v1 as a fallback)
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+enum class cgroup_version {
+  none,
+  v1,
+  v2
+};
+
+struct cgroup_memory_stat {
+  /// Breakdown of the cgroup's charged memory, in bytes; fields the kernel doesn't report are left at zero
+  uint64_t anon{0};
+  uint64_t file{0};
+  uint64_t kernel_stack{0};
+  uint64_t pagetables{0};
+  uint64_t shmem{0};
+  uint64_t file_mapped{0};
+  uint64_t file_dirty{0};
+  uint64_t file_writeback{0};
+  uint64_t swap{0};
+  uint64_t active_anon{0};
+  uint64_t inactive_anon{0};
+  uint64_t active_file{0};
+  uint64_t inactive_file{0};
+  uint64_t unevictable{0};
+  uint64_t slab_reclaimable{0};
+  uint64_t slab_unreclaimable{0};
+};
+
+namespace detail {
+struct cgroup_location {
+  /// Where a memory cgroup lives, as resolved from /proc/self/cgroup and /proc/self/mountinfo
+  cgroup_version version{cgroup_version::none};
+  std::string path;                                                             // this process's cgroup directory
+  std::string mount_point;                                                      // the hierarchy's root as mounted here
+};
+
+cgroup_location find_cgroup(std::string_view cgroup_file,
+                            std::string_view mountinfo_file,
+                            std::function<std::string(std::string const &path)> const &read_first_line);
+
+class cgroup_directories {
+  /// Open descriptors for a cgroup and each ancestor up to the mount point, so queries only read the value files
+  int own{-1};                                                                  // the cgroup itself, -1 if it couldn't be opened
+  std::vector<int> chain;                                                       // every directory that could be opened, innermost first
+
+public:
+  explicit cgroup_directories(cgroup_location const &location);
+  cgroup_directories(cgroup_directories const&) = delete;
+  cgroup_directories &operator=(cgroup_directories const&) = delete;
+  ~cgroup_directories();
+
+  int get_own() const;
+  uint64_t read_limit(char const *name) const;
+  uint64_t read_value(char const *name) const;
+};
+}
+
+cgroup_version get_cgroup_version();
+std::string const &get_cgroup_path();
+
+uint64_t get_cgroup_memory_max();
+uint64_t get_cgroup_memory_high();
+uint64_t get_cgroup_memory_current();
+uint64_t get_cgroup_swap_max();
+cgroup_memory_stat get_cgroup_memory_stat();
+
+uint64_t get_effective_physical_total();
+uint64_t get_effective_physical_available();
+
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+/// Allocation-free serialisation of memory snapshots as JSON, Prometheus exposition text or CSV
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+namespace detail {
+
+struct snapshot_member {
+  std::string_view name;
+  std::string_view help;
+  uint64_t snapshot::*member;
+};
+
+inline constexpr snapshot_member snapshot_members[]{
+  {"stack_available",    "Stack space left on the calling thread",      &snapshot::stack_available},
+  {"physical_total",     "Physical memory installed",                   &snapshot::physical_total},
+  {"physical_available", "Physical memory available to allocate",       &snapshot::physical_available},
+  {"physical_usage",     "Physical memory used by this process",        &snapshot::physical_usage},
+  {"virtual_total",      "Virtual memory limit",                        &snapshot::virtual_total},
+  {"virtual_available",  "Virtual memory available to allocate",        &snapshot::virtual_available},
+  {"virtual_usage",      "Virtual memory used by this process",         &snapshot::virtual_usage},
+};
+
+template<typename OutputIt>
+OutputIt write_text(OutputIt out, std::string_view text) {
+  return std::copy(text.begin(), text.end(), out);
+}
+
+template<typename OutputIt>
+OutputIt write_uint(OutputIt out, uint64_t value) {
+  char digits[20];
+  auto const result{std::to_chars(digits, digits + sizeof(digits), value)};
+  return std::copy(digits, result.ptr, out);
+}
+
+class bounded_writer {
+  /// Output iterator into a fixed buffer that drops and remembers anything that doesn't fit
+  char *position;
+  char *end;
+  bool overflowed{false};
+
+public:
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = void;
+
+  bounded_writer(char *buffer, size_t size)
+    : position{buffer},
+      end{buffer + size} {
+  }
+  bounded_writer &operator=(char value) {
+    if(position == end) {
+      overflowed = true;
+    } else {
+      *position++ = value;
+    }
+    return *this;
+  }
+  bounded_writer &operator*() {
+    return *this;
+  }
+  bounded_writer &operator++() {
+    return *this;
+  }
+  bounded_writer &operator++(int) {
+    return *this;
+  }
+  size_t written(char const *buffer) const {
+    /// Length written, or zero if the output was truncated
+    return overflowed ? 0 : static_cast<size_t>(position - buffer);
+  }
+};
+
+}
+
+template<typename OutputIt>
+OutputIt write_json(OutputIt out, snapshot const &value) {
+  /// A single-line JSON object with one member per field, in bytes
+  out = detail::write_text(out, "{");
+  bool first{true};
+  for(auto const &entry : detail::snapshot_members) {
+    out = detail::write_text(out, first ? "\"" : ",\"");
+    out = detail::write_text(out, entry.name);
+    out = detail::write_text(out, "\":");
+    out = detail::write_uint(out, value.*entry.member);
+    first = false;
+  }
+  return detail::write_text(out, "}");
+}
+
+template<typename OutputIt>
+OutputIt write_prometheus(OutputIt out, snapshot const &value, std::string_view prefix = "memorystorm_") {
+  /// Prometheus text exposition format, one gauge per field named <prefix><field>_bytes
+  for(auto const &entry : detail::snapshot_members) {
+    out = detail::write_text(out, "# HELP ");
+    out = detail::write_text(out, prefix);
+    out = detail::write_text(out, entry.name);
+    out = detail::write_text(out, "_bytes ");
+    out = detail::write_text(out, entry.help);
+    out = detail::write_text(out, "\n# TYPE ");
+    out = detail::write_text(out, prefix);
+    out = detail::write_text(out, entry.name);
+    out = detail::write_text(out, "_bytes gauge\n");
+    out = detail::write_text(out, prefix);
+    out = detail::write_text(out, entry.name);
+    out = detail::write_text(out, "_bytes ");
+    out = detail::write_uint(out, value.*entry.member);
+    out = detail::write_text(out, "\n");
+  }
+  return out;
+}
+
+template<typename OutputIt>
+OutputIt write_csv_header(OutputIt out) {
+  /// Column names matching write_csv(), with a trailing newline
+  bool first{true};
+  for(auto const &entry : detail::snapshot_members) {
+    out = detail::write_text(out, first ? "" : ",");
+    out = detail::write_text(out, entry.name);
+    first = false;
+  }
+  return detail::write_text(out, "\n");
+}
+
+template<typename OutputIt>
+OutputIt write_csv(OutputIt out, snapshot const &value) {
+  /// One CSV row of values in bytes, with a trailing newline
+  bool first{true};
+  for(auto const &entry : detail::snapshot_members) {
+    out = detail::write_text(out, first ? "" : ",");
+    out = detail::write_uint(out, value.*entry.member);
+    first = false;
+  }
+  return detail::write_text(out, "\n");
+}
+
+inline size_t write_json(char *buffer, size_t size, snapshot const &value) {
+  /// Write into a caller's buffer; returns the length written, or 0 if it doesn't fit
+  return write_json(detail::bounded_writer{buffer, size}, value).written(buffer);
+}
+
+inline size_t write_prometheus(char *buffer, size_t size, snapshot const &value, std::string_view prefix = "memorystorm_") {
+  return write_prometheus(detail::bounded_writer{buffer, size}, value, prefix).written(buffer);
+}
+
+inline size_t write_csv_header(char *buffer, size_t size) {
+  return write_csv_header(detail::bounded_writer{buffer, size}).written(buffer);
+}
+
+inline size_t write_csv(char *buffer, size_t size, snapshot const &value) {
+  return write_csv(detail::bounded_writer{buffer, size}, value).written(buffer);
+}
+
+}
@@ -0,0 +1,175 @@
+#include "heap.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include "memorystorm.h"
+#include "platform_defines.h"
+#include "pressure.h"
+#if defined(PLATFORM_MACOS)
+  #include <malloc/malloc.h>
+#elif defined(__GLIBC__)
+  #include <malloc.h>
+  #define MEMORYSTORM_GLIBC_MALLOC
+#endif // platform selection
+
+namespace memorystorm {
+
+namespace {
+
+#if defined(MEMORYSTORM_GLIBC_MALLOC)
+uint32_t count_arenas() {
+  /// glibc only reports the number of arenas in malloc_info's XML, one <heap> element each
+  char *text{nullptr};
+  size_t length{0};
+  FILE *const stream{open_memstream(&text, &length)};
+  if(!stream) {
+    return 0;
+  }
+  malloc_info(0, stream);
+  std::fclose(stream);
+  uint32_t arenas{0};
+  for(char const *it{text}; it && (it = std::strstr(it, "<heap nr=")); ++it) {
+    ++arenas;
+  }
+  std::free(text);
+  return arenas;
+}
+
+template<typename T>
+uint64_t mallinfo_field(T value) {
+  /// Widen a mallinfo field through its unsigned type, so the int fields before glibc 2.33 read up to 4GB rather than sign extending
+  return static_cast<uint64_t>(static_cast<std::make_unsigned_t<T>>(value));
+}
+#endif // defined(MEMORYSTORM_GLIBC_MALLOC)
+
+}
+
+heap_stats get_heap_stats() {
+  /// Read malloc's statistics; this briefly locks each arena, so avoid calling it on latency-critical paths
+  heap_stats result{};
+  #if defined(MEMORYSTORM_GLIBC_MALLOC)
+    #if __GLIBC_PREREQ(2, 33)
+      struct mallinfo2 const info{mallinfo2()};
+    #else
+      struct mallinfo const info{mallinfo()};                                   // fields are int, so wrap beyond 4GB
+    #endif // __GLIBC_PREREQ(2, 33)
+    result.valid = true;
+    result.arena_bytes = mallinfo_field(info.arena);
+    result.mmapped_bytes = mallinfo_field(info.hblkhd);
+    result.in_use_bytes = mallinfo_field(info.uordblks) + mallinfo_field(info.hblkhd);
+    result.free_bytes = mallinfo_field(info.fordblks);
+    result.releasable_bytes = mallinfo_field(info.keepcost);
+    result.free_chunks = mallinfo_field(info.ordblks);
+    result.arenas = count_arenas();
+  #elif defined(PLATFORM_MACOS)
+    malloc_statistics_t info{};
+    malloc_zone_statistics(nullptr, &info);                                     // a null zone sums every zone
+    result.valid = true;
+    result.arena_bytes = info.size_allocated;
+    result.in_use_bytes = info.size_in_use;
+    result.free_bytes = info.size_allocated > info.size_in_use ? info.size_allocated - info.size_in_use : 0;
+    result.arenas = 1;
+  #endif // platform selection
+  result.rss = get_physical_usage();
+  return result;
+}
+
+uint64_t release_free_heap(uint64_t pad) {
+  /// Return free heap memory to the system, leaving pad bytes at the top of the heap; returns the drop in RSS
+  uint64_t const before{get_physical_usage()};
+  #if defined(MEMORYSTORM_GLIBC_MALLOC)
+    malloc_trim(static_cast<size_t>(pad));                                      // also madvises free pages inside every arena, not just the top
+  #elif defined(PLATFORM_MACOS)
+    malloc_zone_pressure_relief(nullptr, 0);
+    (void)pad;
+  #else
+    (void)pad;
+  #endif // platform selection
+  uint64_t const after{get_physical_usage()};
+  return before > after ? before - after : 0;
+}
+
+heap_trimmer::heap_trimmer(heap_trim_policy this_policy)
+  : policy{this_policy},
+    pressure_path{this_policy.pressure_threshold > 0.0 ? get_memory_pressure_path() : std::string{}} {
+}
+
+heap_trimmer::~heap_trimmer() {
+  stop();
+}
+
+bool heap_trimmer::should_trim(heap_stats const &stats) const {
+  /// Whether the policy calls for a trim, ignoring the rate limit
+  if(!stats.valid || stats.free_bytes == 0) {
+    return false;
+  }
+  if(stats.free_bytes >= policy.min_free_bytes && stats.fragmentation_ratio() >= policy.fragmentation_threshold) {
+    return true;
+  }
+  if(policy.pressure_threshold > 0.0 && !pressure_path.empty()) {
+    return get_memory_pressure(pressure_path).some.avg10 >= policy.pressure_threshold;
+  }
+  return false;
+}
+
+heap_trim_result heap_trimmer::check() {
+  /// Trim if the policy calls for it and the last trim was at least min_interval ago; the lock is held throughout, so concurrent checks trim once
+  std::lock_guard<std::mutex> lock{state_mutex};
+  if(last_trim != std::chrono::steady_clock::time_point{} &&
+     std::chrono::steady_clock::now() - last_trim < policy.min_interval) {
+    return {};                                                                  // checked first, so a rate-limited check costs no syscalls
+  }
+  if(!should_trim(get_heap_stats())) {
+    return {};
+  }
+  return trim_locked();
+}
+
+heap_trim_result heap_trimmer::trim() {
+  /// Trim now, regardless of the policy, and restart the rate limit interval
+  std::lock_guard<std::mutex> lock{state_mutex};
+  return trim_locked();
+}
+
+heap_trim_result heap_trimmer::trim_locked() {
+  /// Trim and record it; the caller holds state_mutex
+  heap_trim_result result{};
+  auto const start{std::chrono::steady_clock::now()};
+  result.rss_before = get_physical_usage();
+  release_free_heap(policy.pad);
+  result.rss_after = get_physical_usage();
+  last_trim = std::chrono::steady_clock::now();
+  result.trimmed = true;
+  result.duration = std::chrono::duration_cast<std::chrono::microseconds>(last_trim - start);
+  trims.fetch_add(1, std::memory_order_relaxed);
+  released_bytes.fetch_add(result.released(), std::memory_order_relaxed);
+  return result;
+}
+
+uint64_t heap_trimmer::get_trim_count() const {
+  /// Number of trims performed
+  return trims.load(std::memory_order_relaxed);
+}
+
+uint64_t heap_trimmer::get_released_bytes() const {
+  /// Total drop in RSS across all trims
+  return released_bytes.load(std::memory_order_relaxed);
+}
+
+void heap_trimmer::start(std::chrono::nanoseconds interval) {
+  /// Check on a background thread at the given interval, keeping trims off the threads that serve requests
+  worker.start(interval, [this]{ check(); });
+}
+
+void heap_trimmer::stop() {
+  /// Stop the background checking thread
+  worker.stop();
+}
+
+bool heap_trimmer::running() const {
+  /// Whether the background checking thread is active
+  return worker.running();
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/// Allocator-level heap statistics, and a controller that returns idle malloc memory to the system
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "periodic_worker.h"
+
+namespace memorystorm {
+
+struct heap_stats {
+  /// malloc's own view of the heap, in bytes; valid is false where the allocator can't report it
+  bool valid{false};
+  uint64_t arena_bytes{0};                                                      // obtained from the system for small allocations, across all arenas
+  uint64_t mmapped_bytes{0};                                                    // large allocations mapped individually
+  uint64_t in_use_bytes{0};                                                     // handed out to the program, including mmapped_bytes
+  uint64_t free_bytes{0};                                                       // held by malloc but not in use
+  uint64_t releasable_bytes{0};                                                 // free space at the top of the main heap, which trimming can always return
+  uint64_t free_chunks{0};
+  uint32_t arenas{0};
+  uint64_t rss{0};                                                              // physical usage when the stats were read
+
+  double free_fraction() const {
+    /// Fraction of the memory malloc holds that is free, a measure of heap fragmentation
+    uint64_t const held{in_use_bytes + free_bytes};
+    return held == 0 ? 0.0 : static_cast<double>(free_bytes) / static_cast<double>(held);
+  }
+  double fragmentation_ratio() const {
+    /// Free heap as a fraction of RSS: how much of the process's footprint is memory the program freed but malloc kept
+    return rss == 0 ? 0.0 : std::min(1.0, static_cast<double>(free_bytes) / static_cast<double>(rss));
+  }
+};
+
+heap_stats get_heap_stats();
+uint64_t release_free_heap(uint64_t pad = 0);
+
+struct heap_trim_policy {
+  /// When heap_trimmer returns memory; a trim happens if either trigger fires, at most once per min_interval
+  double fragmentation_threshold{0.25};                                         // free heap as a fraction of RSS
+  uint64_t min_free_bytes{64 * 1024 * 1024};                                    // ignore fragmentation until this much is free
+  double pressure_threshold{10.0};                                              // PSI "some" avg10 percentage, zero to ignore pressure
+  std::chrono::milliseconds min_interval{std::chrono::seconds{10}};
+  uint64_t pad{0};                                                              // free bytes to leave at the top of the heap
+};
+
+struct heap_trim_result {
+  /// Outcome of one heap_trimmer check
+  bool trimmed{false};
+  uint64_t rss_before{0};
+  uint64_t rss_after{0};
+  std::chrono::microseconds duration{0};
+
+  uint64_t released() const {
+    return rss_before > rss_after ? rss_before - rss_after : 0;
+  }
+};
+
+class heap_trimmer {
+  /// Returns idle heap memory to the system when fragmentation or pressure crosses a threshold, rate limited; meant for a background thread
+  heap_trim_policy const policy;
+  std::string const pressure_path;
+  std::chrono::steady_clock::time_point last_trim{};
+  std::atomic<uint64_t> trims{0};
+  std::atomic<uint64_t> released_bytes{0};
+  std::mutex state_mutex;
+
+  detail::periodic_worker worker;
+
+  heap_trim_result trim_locked();
+
+public:
+  explicit heap_trimmer(heap_trim_policy policy = {});
+  heap_trimmer(heap_trimmer const&) = delete;
+  heap_trimmer &operator=(heap_trimmer const&) = delete;
+  ~heap_trimmer();
+
+  bool should_trim(heap_stats const &stats) const;
+  heap_trim_result check();
+  heap_trim_result trim();
+
+  uint64_t get_trim_count() const;
+  uint64_t get_released_bytes() const;
+
+  void start(std::chrono::nanoseconds interval);
+  void stop();
+  bool running() const;
+};
+
+}
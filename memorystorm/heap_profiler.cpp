@@ -0,0 +1,244 @@
+#include "heap_profiler.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <vector>
+#include "alloc_counters.h"
+#include "platform_defines.h"
+#if defined(PLATFORM_WINDOWS)
+  #include <windows.h>
+#elif !defined(PLATFORM_EMSCRIPTEN)
+  #include <execinfo.h>
+#endif // platform selection
+
+namespace memorystorm {
+
+namespace detail {
+
+std::atomic<uint64_t> heap_profile_period{0};
+std::atomic<uint64_t> heap_profile_live_samples{0};
+
+}
+
+namespace {
+
+size_t constexpr max_stack_depth{32};
+size_t constexpr bucket_count{4096};
+
+struct heap_sample {
+  /// One sampled live allocation, allocated with malloc so recording never re-enters operator new
+  void *pointer{nullptr};
+  size_t size{0};
+  size_t depth{0};
+  void *stack[max_stack_depth]{};
+  heap_sample *next{nullptr};
+};
+
+struct alignas(64) bucket {
+  std::atomic_flag lock = ATOMIC_FLAG_INIT;
+  std::atomic<heap_sample*> head{nullptr};                                      // read without the lock to skip empty buckets cheaply
+};
+
+bucket buckets[bucket_count];
+
+class bucket_lock {
+  /// Minimal spinlock guard; a mutex could allocate or need initialisation before main
+  bucket &locked;
+public:
+  explicit bucket_lock(bucket &target) : locked{target} {
+    while(locked.lock.test_and_set(std::memory_order_acquire)) {}
+  }
+  ~bucket_lock() {
+    locked.lock.clear(std::memory_order_release);
+  }
+};
+
+bucket &get_bucket(void *pointer) {
+  /// Hash a pointer to a bucket; allocations are at least 16-byte aligned, so discard the low bits
+  uintptr_t hash{reinterpret_cast<uintptr_t>(pointer) >> 4};
+  hash ^= hash >> 17;
+  hash *= UINT64_C(0x9e3779b97f4a7c15) & UINTPTR_MAX;
+  return buckets[(hash >> 7) % bucket_count];
+}
+
+thread_local uint64_t random_state{0};
+
+double next_random_unit() {
+  /// Per-thread xorshift generator returning a value in (0, 1]
+  if(random_state == 0) {
+    random_state = reinterpret_cast<uintptr_t>(&random_state) ^ UINT64_C(0x2545f4914f6cdd1d);
+  }
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 7;
+  random_state ^= random_state << 17;
+  return (static_cast<double>(random_state >> 11) + 1.0) / 9007199254740992.0; // 2^53
+}
+
+size_t capture_stack(void **stack, size_t depth) {
+  /// Record the return addresses of the current call stack
+  #if defined(PLATFORM_WINDOWS)
+    return CaptureStackBackTrace(0, static_cast<DWORD>(depth), stack, nullptr);
+  #elif defined(PLATFORM_EMSCRIPTEN)
+    (void)stack;
+    (void)depth;
+    return 0;
+  #else
+    int const captured{backtrace(stack, static_cast<int>(depth))};
+    return captured > 0 ? static_cast<size_t>(captured) : 0;
+  #endif // platform selection
+}
+
+void clear_samples() {
+  /// Drop every recorded sample
+  for(auto &this_bucket : buckets) {
+    heap_sample *sample{nullptr};
+    {
+      bucket_lock lock{this_bucket};
+      sample = this_bucket.head.exchange(nullptr, std::memory_order_relaxed);
+    }
+    while(sample) {
+      heap_sample *const next{sample->next};
+      std::free(sample);
+      detail::heap_profile_live_samples.fetch_sub(1, std::memory_order_relaxed);
+      sample = next;
+    }
+  }
+}
+
+}
+
+namespace detail {
+
+int64_t next_heap_sample_interval(uint64_t period) {
+  /// Bytes until the next sample, drawn from an exponential distribution so every byte is equally likely to be sampled
+  double const interval{-std::log(next_random_unit()) * static_cast<double>(period)};
+  return static_cast<int64_t>(interval) + 1;
+}
+
+void record_heap_sample(void *pointer, size_t size) {
+  /// Store a backtrace for a sampled allocation
+  void *const memory{std::malloc(sizeof(heap_sample))};
+  if(!memory) {
+    return;
+  }
+  heap_sample *const sample{new(memory) heap_sample{}};
+  sample->pointer = pointer;
+  sample->size = size;
+  sample->depth = capture_stack(sample->stack, max_stack_depth);
+  bucket &target{get_bucket(pointer)};
+  {
+    bucket_lock lock{target};
+    sample->next = target.head.load(std::memory_order_relaxed);
+    target.head.store(sample, std::memory_order_relaxed);
+  }
+  heap_profile_live_samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void forget_heap_sample(void *pointer) {
+  /// Remove the sample for a freed allocation, if it was sampled
+  bucket &target{get_bucket(pointer)};
+  if(!target.head.load(std::memory_order_relaxed)) {
+    return;                                                                     // the common case: nothing sampled in this bucket
+  }
+  heap_sample *found{nullptr};
+  {
+    bucket_lock lock{target};
+    heap_sample *previous{nullptr};
+    for(heap_sample *sample{target.head.load(std::memory_order_relaxed)}; sample; previous = sample, sample = sample->next) {
+      if(sample->pointer == pointer) {
+        if(previous) {
+          previous->next = sample->next;
+        } else {
+          target.head.store(sample->next, std::memory_order_relaxed);
+        }
+        found = sample;
+        break;
+      }
+    }
+  }
+  if(found) {
+    std::free(found);
+    heap_profile_live_samples.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+}
+
+void start_heap_profiler(uint64_t sample_period) {
+  /// Begin sampling on average one allocation per sample_period bytes
+  void *warm_up[1];
+  capture_stack(warm_up, 1);                                                    // the first backtrace may load the unwinder, so do it now rather than mid-allocation
+  detail::heap_profile_period.store(sample_period == 0 ? 1 : sample_period, std::memory_order_relaxed);
+}
+
+void stop_heap_profiler() {
+  /// Stop sampling and discard the recorded samples
+  detail::heap_profile_period.store(0, std::memory_order_relaxed);
+  clear_samples();
+}
+
+bool heap_profiler_running() {
+  /// Whether allocations are currently being sampled
+  return detail::heap_profile_period.load(std::memory_order_relaxed) != 0;
+}
+
+uint64_t get_heap_profile_sample_count() {
+  /// Number of sampled allocations that are still live
+  return detail::heap_profile_live_samples.load(std::memory_order_relaxed);
+}
+
+std::string get_heap_profile() {
+  /// Format the live samples as a gperftools heap_v2 profile, readable by pprof
+  struct copied_sample {
+    size_t size;
+    size_t depth;
+    void *stack[max_stack_depth];
+  };
+  std::vector<copied_sample> samples;
+  samples.reserve(get_heap_profile_sample_count() + 64);                        // allocate up front: allocating while holding a bucket lock could deadlock
+  for(auto &this_bucket : buckets) {
+    if(!this_bucket.head.load(std::memory_order_relaxed)) {
+      continue;
+    }
+    bucket_lock lock{this_bucket};
+    for(heap_sample const *sample{this_bucket.head.load(std::memory_order_relaxed)}; sample && samples.size() != samples.capacity(); sample = sample->next) {
+      copied_sample copy{sample->size, sample->depth, {}};
+      std::memcpy(copy.stack, sample->stack, sizeof(copy.stack));
+      samples.emplace_back(copy);
+    }
+  }
+
+  uint64_t total_bytes{0};
+  for(auto const &sample : samples) {
+    total_bytes += sample.size;
+  }
+  std::stringstream ss;
+  ss << "heap profile: " << samples.size() << ": " << total_bytes << " [" << samples.size() << ": " << total_bytes << "]"
+     << " @ heap_v2/" << detail::heap_profile_period.load(std::memory_order_relaxed) << "\n";
+  for(auto const &sample : samples) {
+    ss << "1: " << sample.size << " [1: " << sample.size << "] @";
+    for(size_t i{0}; i != sample.depth; ++i) {
+      ss << " 0x" << std::hex << reinterpret_cast<uintptr_t>(sample.stack[i]) << std::dec;
+    }
+    ss << "\n";
+  }
+  #if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+    std::ifstream maps{"/proc/self/maps"};                                      // pprof needs the mappings to symbolise addresses
+    if(maps) {
+      ss << "\nMAPPED_LIBRARIES:\n" << maps.rdbuf();
+    }
+  #endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  return ss.str();
+}
+
+bool dump_heap_profile(std::string const &filename) {
+  /// Write the heap profile to a file for pprof
+  std::ofstream file{filename};
+  file << get_heap_profile();
+  return static_cast<bool>(file);
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+/// Sampling heap profiler writing gperftools-compatible heap profiles for pprof; requires alloc_hooks.cpp to be linked
+
+#include <cstdint>
+#include <string>
+
+namespace memorystorm {
+
+void start_heap_profiler(uint64_t sample_period = 512u * 1024u);
+void stop_heap_profiler();
+bool heap_profiler_running();
+uint64_t get_heap_profile_sample_count();
+
+std::string get_heap_profile();
+bool dump_heap_profile(std::string const &filename);
+
+}
@@ -0,0 +1,276 @@
+#include "hugepages.h"
+#include <algorithm>
+#include <utility>
+#include "platform_defines.h"
+#include "residency.h"
+#if defined(PLATFORM_WINDOWS)
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+    #include <string_view>
+    #include <dirent.h>
+    #include "procfs.h"
+    #include "smaps.h"
+    #define MEMORYSTORM_HUGEPAGES_SUPPORTED
+  #endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+#endif // defined(PLATFORM_WINDOWS)
+
+namespace memorystorm {
+
+namespace {
+
+size_t constexpr size_2mb{size_t{2} * 1024 * 1024};
+size_t constexpr size_1gb{size_t{1024} * 1024 * 1024};
+
+size_t get_base_page_size() {
+  /// The normal page size, the stride for touching each page
+  #if defined(PLATFORM_WINDOWS)
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+  #else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  #endif // defined(PLATFORM_WINDOWS)
+}
+
+size_t round_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+#if defined(MEMORYSTORM_HUGEPAGES_SUPPORTED)
+std::string_view get_selected(char const *buffer, size_t length) {
+  /// The bracketed choice in a sysfs setting such as "always [madvise] never"
+  std::string_view const text{buffer, length};
+  auto const open{text.find('[')};
+  auto const close{text.find(']', open)};
+  if(open == std::string_view::npos || close == std::string_view::npos) {
+    return {};
+  }
+  return text.substr(open + 1, close - open - 1);
+}
+
+uint64_t read_sys_uint(int dirfd, char const *name) {
+  /// A single number from a sysfs file
+  char buffer[32];
+  size_t const length{procfs::read_file(dirfd, name, buffer, sizeof(buffer))};
+  uint64_t value{0};
+  procfs::parse_uint(buffer, buffer + length, value);
+  return value;
+}
+
+void read_pools(std::vector<huge_page_pool> &pools) {
+  /// Each hugepages-<size>kB directory under /sys/kernel/mm/hugepages is one pool
+  DIR *const directory{opendir("/sys/kernel/mm/hugepages")};
+  if(!directory) {
+    return;
+  }
+  while(dirent const *const entry{readdir(directory)}) {
+    std::string_view const name{entry->d_name};
+    if(name.compare(0, 10, "hugepages-") != 0) {
+      continue;
+    }
+    huge_page_pool pool{};
+    procfs::parse_uint(name.data() + 10, name.data() + name.size(), pool.page_size);
+    pool.page_size *= 1024;
+    int const fd{openat(dirfd(directory), entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if(fd < 0) {
+      continue;
+    }
+    pool.total = read_sys_uint(fd, "nr_hugepages");
+    pool.free = read_sys_uint(fd, "free_hugepages");
+    pool.reserved = read_sys_uint(fd, "resv_hugepages");
+    close(fd);
+    pools.emplace_back(pool);
+  }
+  closedir(directory);
+  std::sort(pools.begin(), pools.end(), [](huge_page_pool const &lhs, huge_page_pool const &rhs){
+    return lhs.page_size < rhs.page_size;
+  });
+}
+#endif // defined(MEMORYSTORM_HUGEPAGES_SUPPORTED)
+
+size_t get_thp_size() {
+  /// The transparent huge page size, assuming 2MB where the kernel doesn't say
+  #if defined(MEMORYSTORM_HUGEPAGES_SUPPORTED)
+    static size_t const size{[]{
+      uint64_t const value{read_sys_uint(AT_FDCWD, "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size")};
+      return value == 0 ? size_2mb : static_cast<size_t>(value);
+    }()};
+    return size;
+  #else
+    return size_2mb;
+  #endif // defined(MEMORYSTORM_HUGEPAGES_SUPPORTED)
+}
+
+}
+
+huge_page_status get_huge_page_status() {
+  /// Read the THP settings, huge page usage and explicit huge page pools
+  huge_page_status result{};
+  #if defined(MEMORYSTORM_HUGEPAGES_SUPPORTED)
+    char buffer[128];
+    size_t length{procfs::read_file(AT_FDCWD, "/sys/kernel/mm/transparent_hugepage/enabled", buffer, sizeof(buffer))};
+    std::string_view const mode{get_selected(buffer, length)};
+    result.mode = mode == "always"  ? thp_mode::always
+                : mode == "madvise" ? thp_mode::madvise
+                : mode == "never"   ? thp_mode::never
+                :                     thp_mode::unavailable;
+    length = procfs::read_file(AT_FDCWD, "/sys/kernel/mm/transparent_hugepage/defrag", buffer, sizeof(buffer));
+    std::string_view const defrag{get_selected(buffer, length)};
+    result.defrag = defrag == "always"        ? thp_defrag::always
+                  : defrag == "defer"         ? thp_defrag::defer
+                  : defrag == "defer+madvise" ? thp_defrag::defer_madvise
+                  : defrag == "madvise"       ? thp_defrag::madvise
+                  : defrag == "never"         ? thp_defrag::never
+                  :                             thp_defrag::unavailable;
+    if(result.mode != thp_mode::unavailable) {
+      result.thp_size = get_thp_size();
+    }
+    meminfo const system{get_meminfo(meminfo_field::anon_huge_pages | meminfo_field::shmem_huge_pages)};
+    result.anon_huge_bytes = system.anon_huge_pages;
+    result.shmem_huge_bytes = system.shmem_huge_pages;
+    result.process_anon_huge_bytes = get_smaps_rollup().anon_huge_pages;
+    read_pools(result.pools);
+  #endif // defined(MEMORYSTORM_HUGEPAGES_SUPPORTED)
+  return result;
+}
+
+huge_buffer::huge_buffer(size_t size, huge_page_kind kind, bool populate)
+  : length{size} {
+  /// Map a buffer, trying explicit huge pages first if asked; data() is null if mapping fails
+  if(size == 0) {
+    return;
+  }
+  size_t const explicit_size{kind == huge_page_kind::explicit_1gb ? size_1gb : size_2mb}; // only used for the explicit kinds
+  #if defined(PLATFORM_WINDOWS)
+    if(kind != huge_page_kind::transparent) {
+      size_t const large_page{GetLargePageMinimum()};                           // needs SeLockMemoryPrivilege, so usually falls through
+      if(large_page != 0) {
+        mapped_length = round_up(size, std::max(explicit_size, large_page));
+        address = VirtualAlloc(nullptr, mapped_length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        explicit_pages = address != nullptr;
+      }
+    }
+    if(!address) {
+      mapped_length = round_up(size, get_base_page_size());                     // without large pages there are no huge pages to align to
+      address = VirtualAlloc(nullptr, mapped_length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if(!address) {
+      mapped_length = 0;
+      return;
+    }
+  #else
+    #if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+      if(kind != huge_page_kind::transparent) {
+        int const size_flag{(kind == huge_page_kind::explicit_1gb ? 30 : 21) << MAP_HUGE_SHIFT}; // log2 of the page size
+        size_t const explicit_length{round_up(size, explicit_size)};
+        void *const memory{mmap(nullptr, explicit_length, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag | (populate ? MAP_POPULATE : 0), -1, 0)};
+        if(memory != MAP_FAILED) {
+          address = memory;
+          mapped_length = explicit_length;
+          explicit_pages = true;
+          return;
+        }
+      }
+    #else
+      (void)explicit_size;
+    #endif // defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    size_t const alignment{get_thp_size()};                                     // the explicit kinds fall back to transparent pages, so align for those rather than the pool's size
+    mapped_length = round_up(size, alignment);
+    void *const memory{mmap(nullptr, mapped_length + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)}; // over-allocate, then trim to alignment
+    if(memory == MAP_FAILED) {
+      mapped_length = 0;
+      return;
+    }
+    uintptr_t const start{reinterpret_cast<uintptr_t>(memory)};
+    uintptr_t const aligned{(start + alignment - 1) / alignment * alignment};
+    if(aligned != start) {
+      munmap(memory, aligned - start);
+    }
+    size_t const tail{alignment - (aligned - start)};
+    if(tail != 0) {
+      munmap(reinterpret_cast<void*>(aligned + mapped_length), tail);
+    }
+    address = reinterpret_cast<void*>(aligned);
+    #if defined(MADV_HUGEPAGE)
+      madvise(address, mapped_length, MADV_HUGEPAGE);
+    #endif // defined(MADV_HUGEPAGE)
+  #endif // defined(PLATFORM_WINDOWS)
+  if(populate) {
+    size_t const page_size{get_base_page_size()};
+    for(size_t offset{0}; offset < mapped_length; offset += page_size) {
+      static_cast<char volatile*>(address)[offset] = 0;                         // a write, so pages aren't mapped to the shared zero page
+    }
+  }
+}
+
+huge_buffer::huge_buffer(huge_buffer &&other) noexcept
+  : address{std::exchange(other.address, nullptr)},
+    length{std::exchange(other.length, 0)},
+    mapped_length{std::exchange(other.mapped_length, 0)},
+    explicit_pages{std::exchange(other.explicit_pages, false)} {
+}
+
+huge_buffer &huge_buffer::operator=(huge_buffer &&other) noexcept {
+  if(this != &other) {
+    release();
+    address = std::exchange(other.address, nullptr);
+    length = std::exchange(other.length, 0);
+    mapped_length = std::exchange(other.mapped_length, 0);
+    explicit_pages = std::exchange(other.explicit_pages, false);
+  }
+  return *this;
+}
+
+huge_buffer::~huge_buffer() {
+  release();
+}
+
+void huge_buffer::release() {
+  /// Unmap the buffer, if there is one
+  if(!address) {
+    return;
+  }
+  #if defined(PLATFORM_WINDOWS)
+    VirtualFree(address, 0, MEM_RELEASE);
+  #else
+    munmap(address, mapped_length);
+  #endif // defined(PLATFORM_WINDOWS)
+  address = nullptr;
+}
+
+void *huge_buffer::data() const {
+  /// The start of the buffer, aligned to the huge page size where huge pages are available (on Windows, only with large pages); null if mapping failed
+  return address;
+}
+
+size_t huge_buffer::size() const {
+  /// The size requested; the mapping itself is rounded up to a whole number of huge pages
+  return address ? length : 0;
+}
+
+huge_buffer::operator bool() const {
+  return address != nullptr;
+}
+
+bool huge_buffer::explicit_huge_pages() const {
+  /// Whether the buffer came from an explicit huge page pool, so every page is huge
+  return explicit_pages;
+}
+
+uint64_t huge_buffer::get_huge_page_bytes() const {
+  /// Bytes of the buffer currently backed by huge pages; transparent huge pages only appear once the memory is touched
+  if(!address) {
+    return 0;
+  }
+  if(explicit_pages) {
+    return mapped_length;
+  }
+  page_residency const residency{get_residency(address, mapped_length, residency_field::huge_pages)};
+  return std::min<uint64_t>(residency.huge_page_bytes, mapped_length);
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/// Transparent and explicit huge page status, and buffers backed by huge pages for large, randomly accessed tables
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+enum class thp_mode : uint8_t {
+  unavailable,                                                                  // not Linux, or a kernel without THP
+  always,
+  madvise,                                                                      // only for regions marked with MADV_HUGEPAGE
+  never
+};
+
+enum class thp_defrag : uint8_t {
+  unavailable,
+  always,                                                                       // stall page faults to compact memory
+  defer,                                                                        // compact in the background
+  defer_madvise,
+  madvise,
+  never
+};
+
+struct huge_page_pool {
+  /// Explicit (hugetlbfs) huge pages of one size, as counts of pages
+  uint64_t page_size{0};
+  uint64_t total{0};
+  uint64_t free{0};
+  uint64_t reserved{0};                                                         // promised to mappings but not yet faulted in
+};
+
+struct huge_page_status {
+  /// System huge page settings and usage, in bytes except for the pool counts; Linux only, zero elsewhere
+  thp_mode mode{thp_mode::unavailable};
+  thp_defrag defrag{thp_defrag::unavailable};
+  uint64_t thp_size{0};                                                         // size of a transparent huge page
+  uint64_t anon_huge_bytes{0};                                                  // system-wide transparent huge pages in anonymous memory
+  uint64_t shmem_huge_bytes{0};
+  uint64_t process_anon_huge_bytes{0};                                          // this process's share of anon_huge_bytes
+  std::vector<huge_page_pool> pools;                                            // by page size, smallest first
+};
+
+huge_page_status get_huge_page_status();
+
+enum class huge_page_kind : uint8_t {
+  transparent,                                                                  // aligned to the THP size and marked MADV_HUGEPAGE
+  explicit_2mb,                                                                 // MAP_HUGETLB from the 2MB pool, falling back to transparent
+  explicit_1gb                                                                  // MAP_HUGETLB from the 1GB pool, falling back to transparent
+};
+
+class huge_buffer {
+  /// A zeroed, move-only buffer aligned to the huge page size, mapped directly from the system; Windows only aligns it when large pages are granted
+  void *address{nullptr};
+  size_t length{0};
+  size_t mapped_length{0};
+  bool explicit_pages{false};
+
+  void release();
+
+public:
+  huge_buffer() = default;
+  explicit huge_buffer(size_t size, huge_page_kind kind = huge_page_kind::transparent, bool populate = false);
+  huge_buffer(huge_buffer const&) = delete;
+  huge_buffer &operator=(huge_buffer const&) = delete;
+  huge_buffer(huge_buffer &&other) noexcept;
+  huge_buffer &operator=(huge_buffer &&other) noexcept;
+  ~huge_buffer();
+
+  void *data() const;
+  size_t size() const;
+  explicit operator bool() const;
+
+  bool explicit_huge_pages() const;
+  uint64_t get_huge_page_bytes() const;
+};
+
+}
@@ -1,8 +1,16 @@
 #include "memorystorm.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <iostream>
-#include <iomanip>
+#include "alloc_counters.h"
 #include "platform_defines.h"
+#include "resource.h"
 #if defined(PLATFORM_WINDOWS)
   #include <windows.h>
   #include <psapi.h>
@@ -18,7 +26,15 @@
     #include <sys/sysinfo.h>
   #endif // defined(PLATFORM_EMSCRIPTEN)
   #include <unistd.h>
+  #if !defined(PLATFORM_EMSCRIPTEN)
+    #include <atomic>
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <string_view>
+    #include "procfs.h"
+  #endif // !defined(PLATFORM_EMSCRIPTEN)
 #elif defined(PLATFORM_MACOS)
+  #include <pthread.h>
   //#include <sys/types.h>
   #include <sys/sysctl.h>
   //#include <mach/vm_statistics.h>
@@ -32,286 +48,544 @@
 
 namespace memorystorm {
 
-uint64_t get_stack_available() {
-  /// Measure the available stack space
-  #if defined(PLATFORM_WINDOWS)
-    MEMORY_BASIC_INFORMATION mbi{};                                             // page range
-    VirtualQuery(static_cast<PVOID>(&mbi), &mbi, sizeof(mbi));                  // get range
-    return reinterpret_cast<UINT_PTR>(&mbi) - reinterpret_cast<UINT_PTR>(mbi.AllocationBase); // subtract from top (stack grows downward on win)
-  #elif defined(PLATFORM_LINUX) || defined(PLATFORM_MACOS)
-    #if defined(PLATFORM_EMSCRIPTEN)
-      return emscripten_stack_get_free();
-    #else
-      rlimit limit;                                                             // hard limit and soft limit
-      getrlimit(RLIMIT_STACK, &limit);                                          // stack size availability
-      return std::min(limit.rlim_cur, limit.rlim_max);                          // return the smallest of the two
-    #endif // defined(PLATFORM_EMSCRIPTEN)
-  #endif // platform-specific implementation
+namespace detail {
+
+std::atomic<uint32_t> peak_tracking{0};
+std::atomic<int64_t> peak_live_bytes{0};
+std::atomic<int64_t> peak_live_max{0};
+
+inline namespace MEMORYSTORM_ALLOC_LAYOUT {
+
+std::atomic<alloc_shard*> alloc_shards{nullptr};
+alloc_shard orphan_alloc_shard{};
+std::atomic<bool> alloc_hooks_active{false};
+
+alloc_shard *acquire_alloc_shard() {
+  /// Claim a free shard left behind by an exited thread, or create a new one; must not itself call operator new
+  for(alloc_shard *shard{alloc_shards.load(std::memory_order_acquire)}; shard; shard = shard->next) {
+    bool expected{false};
+    if(!shard->in_use.load(std::memory_order_relaxed) &&
+       shard->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      return shard;
+    }
+  }
+  void *const memory{std::malloc(sizeof(alloc_shard) + alignof(alloc_shard))};  // shards are never freed, as readers may be walking the registry
+  if(!memory) {
+    return &orphan_alloc_shard;
+  }
+  void *aligned{memory};
+  size_t space{sizeof(alloc_shard) + alignof(alloc_shard)};
+  std::align(alignof(alloc_shard), sizeof(alloc_shard), aligned, space);
+  alloc_shard *const shard{new(aligned) alloc_shard{}};
+  shard->in_use.store(true, std::memory_order_relaxed);
+  shard->next = alloc_shards.load(std::memory_order_relaxed);
+  while(!alloc_shards.compare_exchange_weak(shard->next, shard, std::memory_order_release, std::memory_order_relaxed)) {}
+  return shard;
 }
 
-uint64_t get_physical_total() {
-  /// Fetch the total memory of the system
+void release_alloc_shard(alloc_shard *shard) {
+  /// Hand a shard back for reuse when its thread exits; its counts remain part of the totals
+  if(shard && shard != &orphan_alloc_shard) {
+    shard->in_use.store(false, std::memory_order_release);
+  }
+}
+
+}
+
+struct resource_registry {
+  /// Every live arena and pool, so their usage can be reported alongside system memory
+  std::mutex mutex;
+  std::vector<tracked_resource const*> resources;
+};
+
+resource_registry &get_resource_registry() {
+  static resource_registry registry;                                            // function-local so resources can be globals themselves
+  return registry;
+}
+
+thread_local uintptr_t stack_low_bound{0};
+
+uintptr_t init_stack_low_bound() {
+  /// Find the lowest usable address of the calling thread's stack and cache it for subsequent queries
+  uintptr_t low{0};
   #if defined(PLATFORM_WINDOWS)
-    MEMORYSTATUSEX status{};
-    status.dwLength = sizeof(status);
-    GlobalMemoryStatusEx(&status);
-    return cast_if_required<uint64_t>(status.ullTotalPhys);                     // physical memory
+    MEMORY_BASIC_INFORMATION mbi{};                                             // page range
+    VirtualQuery(static_cast<PVOID>(&mbi), &mbi, sizeof(mbi));                  // get range
+    low = reinterpret_cast<uintptr_t>(mbi.AllocationBase);                      // bottom of the reservation (stack grows downward on win)
   #elif defined(PLATFORM_LINUX)
     #if defined(PLATFORM_EMSCRIPTEN)
-      auto device_memory_gb{EM_ASM_INT(
-        return navigator.deviceMemory;
-      )};
-      if(device_memory_gb == 0) {                                               // if navigator.deviceMemory unsupported, fall back to emscripten's max heap
-        return emscripten_get_heap_max();
-      } else {
-        return static_cast<uint64_t>(device_memory_gb) * 1024u * 1024u * 1024u; // value is in gigabytes
-      }
+      low = emscripten_stack_get_end();
     #else
-      //uint64_t pages = sysconf(_SC_PHYS_PAGES);
-      //uint64_t page_size = sysconf(_SC_PAGE_SIZE);
-      //return pages * page_size;
-      // alternative:
-      struct sysinfo info;
-      sysinfo(&info);
-      uint64_t result{info.totalram};
-      result *= info.mem_unit;                                                  // don't collapse this to avoid int overflow on rhs
-      return result;
+      pthread_attr_t attr;
+      if(pthread_getattr_np(pthread_self(), &attr) == 0) {                      // works for the main thread and for threads with custom stack sizes
+        void *address{nullptr};
+        size_t size{0};
+        if(pthread_attr_getstack(&attr, &address, &size) == 0) {
+          low = reinterpret_cast<uintptr_t>(address);
+        }
+        pthread_attr_destroy(&attr);
+      }
+      if(low == 0) {                                                            // fall back to the stack size limit below the current position
+        rlimit limit;
+        getrlimit(RLIMIT_STACK, &limit);
+        uintptr_t const here{get_stack_pointer()};
+        uint64_t const size{std::min<uint64_t>(limit.rlim_cur, here)};
+        low = here - static_cast<uintptr_t>(size);
+      }
     #endif // defined(PLATFORM_EMSCRIPTEN)
   #elif defined(PLATFORM_MACOS)
-    int64_t result{};
-    size_t length{sizeof(result)};
-    int mib[2]{CTL_HW, HW_MEMSIZE};
-    sysctl(mib, 2, &result, &length, nullptr, 0);
-    return result;
+    pthread_t const self{pthread_self()};
+    low = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(self)) - pthread_get_stacksize_np(self); // stackaddr is the top of the stack
   #endif // platform-specific implementation
+  if(low == 0) {
+    low = 1;                                                                    // never leave the cache empty, so we only query once
+  }
+  stack_low_bound = low;
+  return low;
 }
-uint64_t get_physical_available() {
-  /// Fetch the available memory of the system
-  #if defined(PLATFORM_WINDOWS)
-    MEMORYSTATUSEX status{};
-    status.dwLength = sizeof(status);
-    GlobalMemoryStatusEx(&status);
-    return cast_if_required<uint64_t>(status.ullAvailPhys);                     // physical memory
-  #elif defined(PLATFORM_LINUX)
-    #if defined(PLATFORM_EMSCRIPTEN)
-      //return static_cast<uint64_t>(mallinfo().fordblks);
-      return get_physical_total() - get_physical_usage();
-    #else
-      struct sysinfo info;
-      sysinfo(&info);
-      uint64_t totalVirtualMem{info.freeram};
-      totalVirtualMem *= info.mem_unit;                                         // don't collapse this to avoid int overflow on rhs
-      return totalVirtualMem;
-    #endif // defined(PLATFORM_EMSCRIPTEN)
-  #elif defined(PLATFORM_MACOS)
-    mach_port_t mach_port{mach_host_self()};
-    vm_size_t page_size{};
-    vm_statistics64_data_t vm_stats{};
-    mach_msg_type_number_t count{sizeof(vm_stats) / sizeof(natural_t)};
-    if(host_page_size(mach_port, &page_size) == KERN_SUCCESS &&
-       host_statistics64(mach_port, HOST_VM_INFO, reinterpret_cast<host_info64_t>(&vm_stats), &count) == KERN_SUCCESS) {
-      return static_cast<uint64_t>(vm_stats.free_count) * static_cast<uint64_t>(page_size);
-    } else {
-      return 0;
+
+}
+
+
+namespace {
+
+#if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+std::atomic<int> statm_fd{-1};                                                  // persistent descriptor for /proc/self/statm, -1 if not yet open
+
+void statm_fd_reset_after_fork() {
+  /// In a forked child the inherited descriptor still refers to the parent's /proc entry, so drop it
+  int const fd{statm_fd.exchange(-1)};
+  if(fd >= 0) {
+    close(fd);
+  }
+}
+
+int get_statm_fd() {
+  /// Return the persistent /proc/self/statm descriptor, opening it on first use
+  int fd{statm_fd.load(std::memory_order_acquire)};
+  if(fd >= 0) {
+    return fd;
+  }
+  static bool const atfork_registered{pthread_atfork(nullptr, nullptr, statm_fd_reset_after_fork) == 0};
+  (void)atfork_registered;
+  int const opened{open("/proc/self/statm", O_RDONLY | O_CLOEXEC)};
+  if(opened < 0) {
+    return -1;
+  }
+  if(statm_fd.compare_exchange_strong(fd, opened, std::memory_order_acq_rel)) {
+    return opened;
+  }
+  close(opened);                                                                // another thread beat us to it
+  return fd;
+}
+
+void read_proc_statm(uint64_t &physical_usage, uint64_t &virtual_usage) {
+  /// Read the process size and resident set size from /proc/self/statm without allocating
+  static uint64_t const page_size{static_cast<uint64_t>(sysconf(_SC_PAGESIZE))};
+  int const fd{get_statm_fd()};
+  if(fd < 0) {
+    return;
+  }
+  char buffer[128];
+  size_t const length{procfs::read_fd(fd, buffer, sizeof(buffer))};             // pread has no shared file offset, so concurrent callers are safe
+  if(length == 0) {
+    return;
+  }
+  char const *const end{buffer + length};
+  uint64_t size_pages{0};
+  uint64_t resident_pages{0};
+  char const *it{procfs::parse_uint(buffer, end, size_pages)};                  // format: size resident shared text lib data dt
+  if(it != end) {
+    procfs::parse_uint(it + 1, end, resident_pages);
+  }
+  physical_usage = resident_pages * page_size;
+  virtual_usage  = size_pages     * page_size;
+}
+
+struct meminfo_key {
+  std::string_view key;
+  uint64_t meminfo::*member;
+  uint32_t field;
+  uint64_t multiplier;
+};
+
+meminfo_key constexpr meminfo_keys[]{                                           // in the order the kernel prints them
+  {"MemTotal",        &meminfo::mem_total,           meminfo_field::mem_total,           1024},
+  {"MemFree",         &meminfo::mem_free,            meminfo_field::mem_free,            1024},
+  {"MemAvailable",    &meminfo::mem_available,       meminfo_field::mem_available,       1024},
+  {"Buffers",         &meminfo::buffers,             meminfo_field::buffers,             1024},
+  {"Cached",          &meminfo::cached,              meminfo_field::cached,              1024},
+  {"SwapTotal",       &meminfo::swap_total,          meminfo_field::swap_total,          1024},
+  {"SwapFree",        &meminfo::swap_free,           meminfo_field::swap_free,           1024},
+  {"Dirty",           &meminfo::dirty,               meminfo_field::dirty,               1024},
+  {"Writeback",       &meminfo::writeback,           meminfo_field::writeback,           1024},
+  {"AnonPages",       &meminfo::anon_pages,          meminfo_field::anon_pages,          1024},
+  {"Shmem",           &meminfo::shmem,               meminfo_field::shmem,               1024},
+  {"SReclaimable",    &meminfo::slab_reclaimable,    meminfo_field::slab_reclaimable,    1024},
+  {"SUnreclaim",      &meminfo::slab_unreclaimable,  meminfo_field::slab_unreclaimable,  1024},
+  {"CommitLimit",     &meminfo::commit_limit,        meminfo_field::commit_limit,        1024},
+  {"Committed_AS",    &meminfo::committed_as,        meminfo_field::committed_as,        1024},
+  {"AnonHugePages",   &meminfo::anon_huge_pages,     meminfo_field::anon_huge_pages,     1024},
+  {"ShmemHugePages",  &meminfo::shmem_huge_pages,    meminfo_field::shmem_huge_pages,    1024},
+  {"HugePages_Total", &meminfo::huge_pages_total,    meminfo_field::huge_pages_total,    1},
+  {"HugePages_Free",  &meminfo::huge_pages_free,     meminfo_field::huge_pages_free,     1},
+  {"HugePages_Rsvd",  &meminfo::huge_pages_reserved, meminfo_field::huge_pages_reserved, 1},
+  {"HugePages_Surp",  &meminfo::huge_pages_surplus,  meminfo_field::huge_pages_surplus,  1},
+  {"Hugepagesize",    &meminfo::huge_page_size,      meminfo_field::huge_page_size,      1024},
+};
+
+void read_proc_meminfo(meminfo &result, uint32_t fields) {
+  /// Read /proc/meminfo with a single pread on a persistent descriptor, extracting only the requested keys
+  static int const fd{open("/proc/meminfo", O_RDONLY | O_CLOEXEC)};             // system-wide, so safe to keep across forks
+  if(fd < 0) {
+    return;
+  }
+  char buffer[8192];
+  size_t const length{procfs::read_fd(fd, buffer, sizeof(buffer))};
+  uint32_t remaining{fields & meminfo_field::all};
+  char const *const end{buffer + length};
+  char const *it{buffer};
+  while(remaining != 0 && it != end) {
+    char const *const key_begin{it};
+    char const *const colon{static_cast<char const*>(memchr(it, ':', static_cast<size_t>(end - it)))};
+    if(!colon) {
+      break;
     }
-  #endif // platform-specific implementation
+    std::string_view const key{key_begin, static_cast<size_t>(colon - key_begin)};
+    char const *const line_end{static_cast<char const*>(memchr(colon, '\n', static_cast<size_t>(end - colon)))};
+    it = line_end ? line_end + 1 : end;
+    for(auto const &entry : meminfo_keys) {
+      if((remaining & entry.field) && entry.key == key) {
+        uint64_t value{0};
+        procfs::parse_uint(procfs::skip_spaces(colon + 1, end), end, value);
+        result.*entry.member = value * entry.multiplier;
+        remaining &= ~entry.field;
+        break;
+      }
+    }
+  }
 }
-uint64_t get_physical_usage() {
-  /// Fetch the memory used by this process
+#endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+
+}
+
+snapshot take_snapshot(uint32_t fields) {
+  /// Collect the requested memory metrics, querying each underlying source at most once
+  snapshot result{};
+  if(fields & field::stack_available) {
+    result.stack_available = get_stack_available();
+  }
   #if defined(PLATFORM_WINDOWS)
-    PROCESS_MEMORY_COUNTERS counters{};
-    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
-    return counters.WorkingSetSize;                                             // physical memory used
+    if(fields & field::system) {
+      MEMORYSTATUSEX status{};
+      status.dwLength = sizeof(status);
+      GlobalMemoryStatusEx(&status);
+      result.physical_total     = cast_if_required<uint64_t>(status.ullTotalPhys); // physical memory
+      result.physical_available = cast_if_required<uint64_t>(status.ullAvailPhys);
+      result.virtual_total      = cast_if_required<uint64_t>(status.ullTotalPageFile); // total virtual memory (including swapfiles)
+      result.virtual_available  = cast_if_required<uint64_t>(status.ullAvailPageFile); // available virtual memory (including swapfiles)
+    }
+    if(fields & field::process) {
+      PROCESS_MEMORY_COUNTERS_EX counters{};
+      GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters));
+      result.physical_usage = counters.WorkingSetSize;                          // physical memory used
+      result.virtual_usage  = counters.PrivateUsage;                            // virtual memory used
+    }
   #elif defined(PLATFORM_LINUX)
     #if defined(PLATFORM_EMSCRIPTEN)
-      auto used_js_heap_size{reinterpret_cast<uint64_t>(EM_ASM_PTR(
-        return performance.memory.usedJSHeapSize;
-      ))};
-      if(used_js_heap_size == 0) {                                              // if performance.memory isn't available, fall back to mallinfo
-        return static_cast<uint64_t>(mallinfo().uordblks);
-      } else {
-        return used_js_heap_size;
+      if(fields & (field::physical_total | field::physical_available)) {
+        auto device_memory_gb{EM_ASM_INT(
+          return navigator.deviceMemory;
+        )};
+        if(device_memory_gb == 0) {                                             // if navigator.deviceMemory unsupported, fall back to emscripten's max heap
+          result.physical_total = emscripten_get_heap_max();
+        } else {
+          result.physical_total = static_cast<uint64_t>(device_memory_gb) * 1024u * 1024u * 1024u; // value is in gigabytes
+        }
+      }
+      if(fields & (field::process | field::physical_available | field::virtual_available)) {
+        auto used_js_heap_size{reinterpret_cast<uint64_t>(EM_ASM_PTR(
+          return performance.memory.usedJSHeapSize;
+        ))};
+        if(used_js_heap_size == 0) {                                            // if performance.memory isn't available, fall back to mallinfo
+          result.physical_usage = static_cast<uint64_t>(mallinfo().uordblks);
+        } else {
+          result.physical_usage = used_js_heap_size;
+        }
+        result.virtual_usage = result.physical_usage;
+      }
+      if(fields & (field::virtual_total | field::virtual_available)) {
+        auto total_js_heap_size{reinterpret_cast<uint64_t>(EM_ASM_PTR(
+          return performance.memory.totalJSHeapSize;
+        ))};
+        if(total_js_heap_size == 0) {                                           // if performance.memory isn't available, fall back to emscripten's heap max
+          result.virtual_total = emscripten_get_heap_max();
+        } else {
+          result.virtual_total = std::max(total_js_heap_size, static_cast<uint64_t>(emscripten_get_heap_max()));
+        }
+      }
+      if(fields & field::physical_available) {
+        result.physical_available = result.physical_total > result.physical_usage ? result.physical_total - result.physical_usage : 0; // usage can exceed a deviceMemory estimate
+      }
+      if(fields & field::virtual_available) {
+        result.virtual_available = result.virtual_total > result.virtual_usage ? result.virtual_total - result.virtual_usage : 0;
       }
     #else
-      FILE *file{fopen("/proc/self/status", "r")};
-      uint64_t result{0};
-      char line[128];
-      while(fgets(line, 128, file) != nullptr) {
-        if(strncmp(line, "VmRSS:", 6) == 0) {
-          char *templine{line};
-          size_t const length{strlen(templine)};
-          while(*templine < '0' || *templine > '9') {
-            ++templine;
-          }
-          templine[length - 3] = '\0';
-          result = static_cast<uint64_t>(std::atoll(templine)) * uint64_t{1024u}; // value is kilobytes
-          break;
+      if(fields & field::system) {
+        struct sysinfo info;
+        sysinfo(&info);
+        result.physical_total = info.totalram;
+        result.physical_total *= info.mem_unit;                                 // don't collapse this to avoid int overflow on rhs
+        result.physical_available = info.freeram;
+        result.physical_available *= info.mem_unit;
+        result.virtual_total = info.totalram;
+        result.virtual_total += info.totalswap;                                 // Add other values in next statement to avoid int overflow on right hand side...
+        result.virtual_total *= info.mem_unit;
+        result.virtual_available = info.freeram;
+        result.virtual_available += info.freeswap;
+        result.virtual_available *= info.mem_unit;
+      }
+      if(fields & field::process) {
+        uint64_t physical_usage{0};
+        uint64_t virtual_usage{0};
+        read_proc_statm(physical_usage, virtual_usage);
+        if(fields & field::physical_usage) {
+          result.physical_usage = physical_usage;
+        }
+        if(fields & field::virtual_usage) {
+          result.virtual_usage = virtual_usage;
         }
       }
-      fclose(file);
-      return result;
     #endif // defined(PLATFORM_EMSCRIPTEN)
   #elif defined(PLATFORM_MACOS)
-    struct task_basic_info info{};
-    mach_msg_type_number_t info_count{TASK_BASIC_INFO_COUNT};
-    if(task_info(mach_task_self(), TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &info_count) != KERN_SUCCESS) {
-      return 0;
+    if(fields & field::physical_total) {
+      int64_t total{};
+      size_t length{sizeof(total)};
+      int mib[2]{CTL_HW, HW_MEMSIZE};
+      sysctl(mib, 2, &total, &length, nullptr, 0);
+      result.physical_total = static_cast<uint64_t>(total);
+    }
+    if(fields & field::physical_available) {
+      mach_port_t mach_port{mach_host_self()};
+      vm_size_t page_size{};
+      vm_statistics64_data_t vm_stats{};
+      mach_msg_type_number_t count{sizeof(vm_stats) / sizeof(natural_t)};
+      if(host_page_size(mach_port, &page_size) == KERN_SUCCESS &&
+         host_statistics64(mach_port, HOST_VM_INFO, reinterpret_cast<host_info64_t>(&vm_stats), &count) == KERN_SUCCESS) {
+        result.physical_available = static_cast<uint64_t>(vm_stats.free_count) * static_cast<uint64_t>(page_size);
+      }
+    }
+    if(fields & (field::virtual_total | field::virtual_available)) {
+      xsw_usage xsu{0, 0, 0, 0, 0};
+      size_t size{sizeof(xsu)};
+      if(sysctlbyname("vm.swapusage", &xsu, &size, nullptr, 0) != 0) {
+        perror("unable to get swap usage by calling sysctlbyname(\"vm.swapusage\",...)");
+      }
+      result.virtual_total     = xsu.xsu_total;
+      result.virtual_available = xsu.xsu_avail;
+    }
+    if(fields & field::process) {
+      struct task_basic_info info{};
+      mach_msg_type_number_t info_count{TASK_BASIC_INFO_COUNT};
+      if(task_info(mach_task_self(), TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &info_count) == KERN_SUCCESS) {
+        result.physical_usage = info.resident_size;
+        result.virtual_usage  = info.virtual_size;
+      }
     }
-    return info.resident_size;
   #endif // platform-specific implementation
+  return result;
 }
 
-uint64_t get_virtual_total() {
+uint64_t get_physical_total() {
   /// Fetch the total memory of the system
-  #if defined(PLATFORM_WINDOWS)
-    MEMORYSTATUSEX status{};
-    status.dwLength = sizeof(status);
-    GlobalMemoryStatusEx(&status);
-    return cast_if_required<uint64_t>(status.ullTotalPageFile);                 // total virtual memory (including swapfiles)
-  #elif defined(PLATFORM_LINUX)
-    #if defined(PLATFORM_EMSCRIPTEN)
-      auto total_js_heap_size{reinterpret_cast<uint64_t>(EM_ASM_PTR(
-        return performance.memory.totalJSHeapSize;
-      ))};
-      if(total_js_heap_size == 0) {                                             // if performance.memory isn't available, fall back to emscripten's heap max
-        return emscripten_get_heap_max();
-      } else {
-        return std::max(total_js_heap_size, static_cast<uint64_t>(emscripten_get_heap_max()));
+  return take_snapshot(field::physical_total).physical_total;
+}
+uint64_t get_physical_available(available_mode mode) {
+  /// Fetch the available memory of the system, optionally counting memory the kernel can reclaim
+  #if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+    if(mode == available_mode::reclaimable) {
+      meminfo const info{get_meminfo(meminfo_field::mem_available)};
+      if(info.mem_available != 0) {                                             // MemAvailable is missing before Linux 3.14
+        return info.mem_available;
       }
-    #else
-      struct sysinfo info;
-      sysinfo(&info);
-      uint64_t result{info.totalram};
-      result += info.totalswap;                                                 // Add other values in next statement to avoid int overflow on right hand side...
-      result *= info.mem_unit;
-      return result;
-    #endif // defined(PLATFORM_EMSCRIPTEN)
-  #elif defined(PLATFORM_MACOS)
-    xsw_usage xsu{0, 0, 0, 0, 0};
-    size_t size{sizeof(xsu)};
-    if(sysctlbyname("vm.swapusage", &xsu, &size, nullptr, 0) != 0) {
-      perror("unable to get swap usage by calling sysctlbyname(\"vm.swapusage\",...)");
     }
-    return xsu.xsu_total;
-  #endif // platform-specific implementation
+  #else
+    (void)mode;                                                                 // only Linux distinguishes reclaimable memory at present
+  #endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  return take_snapshot(field::physical_available).physical_available;
+}
+uint64_t get_physical_usage() {
+  /// Fetch the memory used by this process
+  return take_snapshot(field::physical_usage).physical_usage;
+}
+
+meminfo get_meminfo(uint32_t fields) {
+  /// Fetch the detailed system memory breakdown
+  meminfo result{};
+  #if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+    read_proc_meminfo(result, fields);
+  #else
+    (void)fields;
+  #endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  return result;
+}
+
+uint64_t get_virtual_total() {
+  /// Fetch the total memory of the system
+  return take_snapshot(field::virtual_total).virtual_total;
 }
 uint64_t get_virtual_available() {
   /// Fetch the available memory of the system
-  #if defined(PLATFORM_WINDOWS)
-    MEMORYSTATUSEX status{};
-    status.dwLength = sizeof(status);
-    GlobalMemoryStatusEx(&status);
-    return cast_if_required<uint64_t>(status.ullAvailPageFile);                 // available virtual memory (including swapfiles)
-  #elif defined(PLATFORM_LINUX)
-    #if defined(PLATFORM_EMSCRIPTEN)
-      //return emscripten_get_heap_size();
-      return get_virtual_total() - get_virtual_usage();
-    #else
-      struct sysinfo info;
-      sysinfo(&info);
-      uint64_t result{info.freeram};
-      result += info.freeswap;                                                  // Add other values in next statement to avoid int overflow on right hand side...
-      result *= info.mem_unit;
-      return result;
-    #endif // defined(PLATFORM_EMSCRIPTEN)
-  #elif defined(PLATFORM_MACOS)
-    xsw_usage xsu{0, 0, 0, 0, 0};
-    size_t size{sizeof(xsu)};
-    if(sysctlbyname("vm.swapusage", &xsu, &size, nullptr, 0) != 0) {
-      perror("unable to get swap usage by calling sysctlbyname(\"vm.swapusage\",...)");
-    }
-    return xsu.xsu_avail;
-  #endif // platform-specific implementation
+  return take_snapshot(field::virtual_available).virtual_available;
 }
 uint64_t get_virtual_usage() {
   /// Fetch the memory used by this process
-  #if defined(PLATFORM_WINDOWS)
-    PROCESS_MEMORY_COUNTERS_EX counters{};
-    //GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
-    //GetProcessMemoryInfo(GetCurrentProcess(), static_cast<PPROCESS_MEMORY_COUNTERS>(&counters), sizeof(counters));
-    GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters));
-    return counters.PrivateUsage;                                               // virtual memory used
-  #elif defined(PLATFORM_LINUX)
-    #if defined(PLATFORM_EMSCRIPTEN)
-      return get_physical_usage();
-    #else
-      FILE *file{fopen("/proc/self/status", "r")};
-      uint64_t result{0};
-      char line[128];
-      while(fgets(line, 128, file) != nullptr) {
-        if(strncmp(line, "VmSize:", 7) == 0) {
-          char *templine{line};
-          size_t const length{strlen(templine)};
-          while(*templine < '0' || *templine > '9') {
-            ++templine;
-          }
-          templine[length - 3] = '\0';
-          result = static_cast<uint64_t>(std::atoll(templine)) * uint64_t{1024u}; // value is kilobytes
+  return take_snapshot(field::virtual_usage).virtual_usage;
+}
+
+alloc_stats get_alloc_stats() {
+  /// Sum the allocation counters across all thread shards; returns zeroes unless the allocation hooks are linked in
+  alloc_stats result{};
+  auto const add{[&result](detail::alloc_shard const &shard){
+    result.allocated_bytes += shard.allocated_bytes.load(std::memory_order_relaxed);
+    result.freed_bytes     += shard.freed_bytes.load(std::memory_order_relaxed);
+    result.allocations     += shard.allocations.load(std::memory_order_relaxed);
+    result.deallocations   += shard.deallocations.load(std::memory_order_relaxed);
+  }};
+  for(detail::alloc_shard const *shard{detail::alloc_shards.load(std::memory_order_acquire)}; shard; shard = shard->next) {
+    add(*shard);
+  }
+  add(detail::orphan_alloc_shard);
+  return result;
+}
+
+bool alloc_hooks_installed() {
+  /// Whether the optional global operator new/delete replacements are linked into this program
+  return detail::alloc_hooks_active.load(std::memory_order_relaxed);
+}
+
+size_t human_readable_to(uint64_t amount, char *buffer, size_t size) {
+  /// Format a size in bytes into a caller's buffer without allocating; returns the length written, or 0 if it doesn't fit
+  static char const *const units[]{"KB", "MB", "GB", "TB", "PB"};
+  char *const end{buffer + size};
+  std::to_chars_result result;
+  char const *unit{"B"};
+  if(amount < 1'024) {
+    result = std::to_chars(buffer, end, amount);
+  } else {
+    uint64_t scale{1'024};
+    size_t index{0};
+    while(index != 4 && amount >= scale * 1'024) {
+      scale *= 1'024;
+      ++index;
+    }
+    unit = units[index];
+    if(amount < scale * 10) {                                                   // two significant figures for small multiples, e.g. 1.5KB
+      uint64_t const scaled{amount / (scale / 1'024) * 10};                     // tenths of the unit, times 1024; integers only, as floating point to_chars is missing from older standard libraries
+      uint64_t tenths{scaled / 1'024};
+      uint64_t const remainder{scaled % 1'024};
+      if(remainder > 512 || (remainder == 512 && tenths % 2 != 0)) {            // round half to even, as printf would
+        ++tenths;
+      }
+      result = std::to_chars(buffer, end, tenths / 10);
+      if(result.ec == std::errc{} && tenths % 10 != 0) {
+        if(end - result.ptr < 2) {
+          return 0;
         }
+        result.ptr[0] = '.';
+        result.ptr[1] = static_cast<char>('0' + tenths % 10);
+        result.ptr += 2;
       }
-      fclose(file);
-      return result;
-    #endif // defined(PLATFORM_EMSCRIPTEN)
-  #elif defined(PLATFORM_MACOS)
-    struct task_basic_info info{};
-    mach_msg_type_number_t info_count{TASK_BASIC_INFO_COUNT};
-    if(task_info(mach_task_self(), TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &info_count) != KERN_SUCCESS) {
-      return 0;
+    } else {
+      result = std::to_chars(buffer, end, amount / scale);
     }
-    return info.virtual_size;
-  #endif // platform-specific implementation
+  }
+  size_t const unit_length{std::strlen(unit)};
+  if(result.ec != std::errc{} || static_cast<size_t>(end - result.ptr) < unit_length) {
+    return 0;
+  }
+  std::memcpy(result.ptr, unit, unit_length);
+  return static_cast<size_t>(result.ptr - buffer) + unit_length;
 }
 
 std::string human_readable(uint64_t amount) {
   /// Helper function to convert a size in bytes to a human readable size
-  std::stringstream ss;
-  uint64_t constexpr kilobyte{1'024};
-  uint64_t constexpr megabyte{kilobyte * 1'024};
-  uint64_t constexpr gigabyte{megabyte * 1'024};
-  uint64_t constexpr terabyte{gigabyte * 1'024};
-  uint64_t constexpr petabyte{terabyte * 1'024};
-  if(amount < kilobyte) {
-    ss << amount << "B";
-  } else if(amount < kilobyte * 10) {
-    ss << std::setprecision(2) << static_cast<float>(amount) / kilobyte << "KB";
-  } else if(amount < megabyte) {
-    ss << amount / kilobyte << "KB";
-  } else if(amount < megabyte * 10) {
-    ss << std::setprecision(2) << static_cast<float>(amount / kilobyte) / kilobyte << "MB";
-  } else if(amount < gigabyte) {
-    ss << amount / megabyte << "MB";
-  } else if(amount < gigabyte * 10) {
-    ss << std::setprecision(2) << static_cast<float>(amount / megabyte) / kilobyte << "GB";
-  } else if(amount < terabyte) {
-    ss << amount / gigabyte << "GB";
-  } else if(amount < terabyte * 10) {
-    ss << std::setprecision(2) << static_cast<float>(amount / gigabyte) / kilobyte << "TB";
-  } else if(amount < petabyte) {
-    ss << amount / terabyte << "TB";
-  } else if(amount < petabyte * 10) {
-    ss << std::setprecision(2) << static_cast<float>(amount / terabyte) / kilobyte << "PB";
-  } else {
-    ss << amount / petabyte << "PB";
+  char buffer[human_readable_max_length];
+  return std::string(buffer, human_readable_to(amount, buffer, sizeof(buffer)));
+}
+
+tracked_resource::tracked_resource(std::string this_name, uint64_t this_budget)
+  : name{std::move(this_name)},
+    budget{this_budget} {
+  auto &registry{detail::get_resource_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  registry.resources.emplace_back(this);
+}
+
+tracked_resource::~tracked_resource() {
+  auto &registry{detail::get_resource_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  registry.resources.erase(std::remove(registry.resources.begin(), registry.resources.end(), this), registry.resources.end());
+}
+
+allocator_stats tracked_resource::get_usage() const {
+  /// Current usage of this resource
+  allocator_stats result;
+  result.name               = name;
+  result.reserved_bytes     = reserved.load(std::memory_order_relaxed);
+  result.used_bytes         = used.load(std::memory_order_relaxed);
+  result.peak_used_bytes    = peak.load(std::memory_order_relaxed);
+  result.budget             = budget;
+  result.failed_allocations = failures.load(std::memory_order_relaxed);
+  return result;
+}
+
+std::vector<allocator_stats> get_allocator_stats() {
+  /// Usage of every live arena and pool
+  auto &registry{detail::get_resource_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  std::vector<allocator_stats> result;
+  result.reserve(registry.resources.size());
+  for(auto const *resource : registry.resources) {
+    result.emplace_back(resource->get_usage());
   }
-  return ss.str();
+  return result;
 }
 
 std::string get_stats() {
   /// Return summary in string
+  snapshot const current{take_snapshot()};
   std::stringstream ss;
-  ss << "MemoryStorm: Stack available " << human_readable(get_stack_available()) << std::endl <<
-        "MemoryStorm: Physical usage "  << human_readable(get_physical_usage()) << ", " <<
-                                           human_readable(get_physical_available()) << " available of " <<
-                                           human_readable(get_physical_total()) << std::endl <<
-        "MemoryStorm: Virtual usage "   << human_readable(get_virtual_usage()) << ", " <<
-                                           human_readable(get_virtual_available()) << " available of " <<
-                                           human_readable(get_virtual_total());
+  ss << "MemoryStorm: Stack available " << human_readable(current.stack_available) << std::endl <<
+        "MemoryStorm: Physical usage "  << human_readable(current.physical_usage) << ", " <<
+                                           human_readable(current.physical_available) << " available of " <<
+                                           human_readable(current.physical_total) << std::endl <<
+        "MemoryStorm: Virtual usage "   << human_readable(current.virtual_usage) << ", " <<
+                                           human_readable(current.virtual_available) << " available of " <<
+                                           human_readable(current.virtual_total);
+  for(auto const &resource : get_allocator_stats()) {
+    ss << std::endl <<
+          "MemoryStorm: Allocator "     << resource.name << " using " <<
+                                           human_readable(resource.used_bytes) << " of " <<
+                                           human_readable(resource.reserved_bytes) << " reserved";
+    if(resource.budget != unlimited) {
+      ss << ", budget " << human_readable(resource.budget);
+    }
+  }
+  if(alloc_hooks_installed()) {
+    alloc_stats const heap{get_alloc_stats()};
+    ss << std::endl <<
+          "MemoryStorm: Heap live "     << human_readable(heap.live_bytes()) << " in " <<
+                                           heap.live_allocations() << " allocations, " <<
+                                           human_readable(heap.allocated_bytes) << " allocated in " <<
+                                           heap.allocations << " allocations in total";
+  }
   return ss.str();
-} // namespace memorystorm
+}
 
 void dump_stats() {
   /// Dump stats summary to console
   std::cout << get_stats() << std::endl;
 }
 
-}
+} // namespace memorystorm
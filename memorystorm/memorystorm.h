@@ -2,21 +2,175 @@
 
 /// Functionality for querying operating system memory across all platforms
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
 namespace memorystorm {
 
-uint64_t get_stack_available();
+uint64_t constexpr unlimited{UINT64_MAX};                                       // reported for limits that are not set
+
+namespace field {
+uint32_t constexpr stack_available{   1u << 0};
+uint32_t constexpr physical_total{    1u << 1};
+uint32_t constexpr physical_available{1u << 2};
+uint32_t constexpr physical_usage{    1u << 3};
+uint32_t constexpr virtual_total{     1u << 4};
+uint32_t constexpr virtual_available{ 1u << 5};
+uint32_t constexpr virtual_usage{     1u << 6};
+
+uint32_t constexpr system{physical_total | physical_available | virtual_total | virtual_available};
+uint32_t constexpr process{physical_usage | virtual_usage};
+uint32_t constexpr all{stack_available | system | process};
+}
+
+struct snapshot {
+  /// A consistent set of memory metrics collected together; fields not requested are left at zero unless they share a query with a requested field
+  uint64_t stack_available{0};
+  uint64_t physical_total{0};
+  uint64_t physical_available{0};
+  uint64_t physical_usage{0};
+  uint64_t virtual_total{0};
+  uint64_t virtual_available{0};
+  uint64_t virtual_usage{0};
+};
+
+snapshot take_snapshot(uint32_t fields = field::all);
+
+namespace meminfo_field {
+uint32_t constexpr mem_total{       1u << 0};
+uint32_t constexpr mem_free{        1u << 1};
+uint32_t constexpr mem_available{   1u << 2};
+uint32_t constexpr buffers{         1u << 3};
+uint32_t constexpr cached{          1u << 4};
+uint32_t constexpr swap_total{      1u << 5};
+uint32_t constexpr swap_free{       1u << 6};
+uint32_t constexpr dirty{           1u << 7};
+uint32_t constexpr writeback{       1u << 8};
+uint32_t constexpr anon_pages{      1u << 9};
+uint32_t constexpr shmem{           1u << 10};
+uint32_t constexpr slab_reclaimable{1u << 11};
+uint32_t constexpr slab_unreclaimable{1u << 12};
+uint32_t constexpr commit_limit{    1u << 13};
+uint32_t constexpr committed_as{    1u << 14};
+uint32_t constexpr anon_huge_pages{ 1u << 15};
+uint32_t constexpr shmem_huge_pages{1u << 16};
+uint32_t constexpr huge_pages_total{1u << 17};
+uint32_t constexpr huge_pages_free{ 1u << 18};
+uint32_t constexpr huge_pages_reserved{1u << 19};
+uint32_t constexpr huge_pages_surplus{1u << 20};
+uint32_t constexpr huge_page_size{  1u << 21};
+
+uint32_t constexpr all{(1u << 22) - 1};
+}
+
+struct meminfo {
+  /// System memory breakdown from /proc/meminfo in bytes, except for the huge page counts; Linux only, zero elsewhere
+  uint64_t mem_total{0};
+  uint64_t mem_free{0};
+  uint64_t mem_available{0};                                                    // free memory plus what can be reclaimed without swapping
+  uint64_t buffers{0};
+  uint64_t cached{0};
+  uint64_t swap_total{0};
+  uint64_t swap_free{0};
+  uint64_t dirty{0};
+  uint64_t writeback{0};
+  uint64_t anon_pages{0};
+  uint64_t shmem{0};
+  uint64_t slab_reclaimable{0};
+  uint64_t slab_unreclaimable{0};
+  uint64_t commit_limit{0};
+  uint64_t committed_as{0};
+  uint64_t anon_huge_pages{0};
+  uint64_t shmem_huge_pages{0};
+  uint64_t huge_pages_total{0};                                                 // count of pages
+  uint64_t huge_pages_free{0};                                                  // count of pages
+  uint64_t huge_pages_reserved{0};                                              // count of pages
+  uint64_t huge_pages_surplus{0};                                               // count of pages
+  uint64_t huge_page_size{0};
+};
+
+meminfo get_meminfo(uint32_t fields = meminfo_field::all);
+
+enum class available_mode {
+  free,                                                                         // memory not in use at all
+  reclaimable                                                                   // also counts page cache and slab the kernel can reclaim (MemAvailable on Linux)
+};
+
+namespace detail {
+extern thread_local uintptr_t stack_low_bound;                                  // lowest usable stack address of this thread, zero until first queried
+uintptr_t init_stack_low_bound();
+
+inline uintptr_t get_stack_low_bound() {
+  /// Cached per-thread stack bound; after the first call this is a single TLS read
+  uintptr_t const low{stack_low_bound};
+  return low != 0 ? low : init_stack_low_bound();
+}
+
+inline uintptr_t get_stack_pointer() {
+  /// Approximate current stack position
+  #if defined(__GNUC__) || defined(__clang__)
+    return reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+  #else
+    char volatile marker{0};
+    return reinterpret_cast<uintptr_t>(&marker);
+  #endif
+}
+}
+
+inline uint64_t get_stack_available() {
+  /// Stack space remaining to the calling thread (all supported platforms grow the stack downward)
+  uintptr_t const low{detail::get_stack_low_bound()};
+  uintptr_t const here{detail::get_stack_pointer()};
+  return here > low ? here - low : 0;
+}
+
+class stack_guard {
+  /// Cheap recursion guard: precomputes the lowest safe stack address for this thread, so each check is one compare
+  uintptr_t const limit;
+
+public:
+  explicit stack_guard(uint64_t reserve = 64u * 1024u)
+    : limit{detail::get_stack_low_bound() + static_cast<uintptr_t>(reserve)} {
+  }
+
+  bool exhausted() const {
+    /// True once less than the reserve remains; only valid on the thread that created the guard
+    return detail::get_stack_pointer() < limit;
+  }
+  explicit operator bool() const {
+    return !exhausted();
+  }
+};
 
 uint64_t get_physical_total();
-uint64_t get_physical_available();
+uint64_t get_physical_available(available_mode mode = available_mode::free);
 uint64_t get_physical_usage();
 
 uint64_t get_virtual_total();
 uint64_t get_virtual_available();
 uint64_t get_virtual_usage();
 
+struct alloc_stats {
+  /// Totals counted by the optional allocation hooks (alloc_hooks.cpp); take the difference of two reads for rates
+  uint64_t allocated_bytes{0};
+  uint64_t freed_bytes{0};
+  uint64_t allocations{0};
+  uint64_t deallocations{0};
+
+  uint64_t live_bytes() const {
+    return allocated_bytes > freed_bytes ? allocated_bytes - freed_bytes : 0;   // shards are read independently, so clamp rather than wrap
+  }
+  uint64_t live_allocations() const {
+    return allocations > deallocations ? allocations - deallocations : 0;
+  }
+};
+
+alloc_stats get_alloc_stats();
+bool alloc_hooks_installed();
+
+size_t constexpr human_readable_max_length{16};                                 // enough for any value human_readable_to() can produce
+size_t human_readable_to(uint64_t amount, char *buffer, size_t size);
 std::string human_readable(uint64_t amount);
 std::string get_stats();
 void dump_stats();
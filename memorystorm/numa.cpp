@@ -0,0 +1,262 @@
+#include "numa.h"
+#include <algorithm>
+#include "platform_defines.h"
+#if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  #include <charconv>
+  #include <string_view>
+  #include <sys/syscall.h>
+  #include "procfs.h"
+  #if defined(SYS_move_pages)
+    #define MEMORYSTORM_MOVE_PAGES_SUPPORTED
+  #endif // defined(SYS_move_pages)
+  #define MEMORYSTORM_NUMA_SUPPORTED
+#endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+
+namespace memorystorm {
+
+namespace {
+
+#if defined(MEMORYSTORM_NUMA_SUPPORTED)
+struct node_key {
+  std::string_view key;
+  uint64_t numa_node_memory::*member;
+};
+
+node_key constexpr node_keys[]{                                                 // all in kB
+  {"MemTotal",       &numa_node_memory::total},
+  {"MemFree",        &numa_node_memory::free},
+  {"MemUsed",        &numa_node_memory::used},
+  {"Active(file)",   &numa_node_memory::active_file},
+  {"Inactive(file)", &numa_node_memory::inactive_file},
+  {"FilePages",      &numa_node_memory::file_pages},
+  {"AnonPages",      &numa_node_memory::anon_pages},
+  {"Shmem",          &numa_node_memory::shmem},
+  {"SReclaimable",   &numa_node_memory::slab_reclaimable},
+};
+
+int get_node_dirfd() {
+  /// The node directory, opened once
+  static int const fd{open("/sys/devices/system/node", O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+  return fd;
+}
+
+numa_process_memory &get_node_entry(std::vector<numa_process_memory> &nodes, uint32_t node) {
+  /// Find or add the entry for a node, keeping the list sorted by node
+  auto it{std::lower_bound(nodes.begin(), nodes.end(), node, [](numa_process_memory const &entry, uint32_t value){
+    return entry.node < value;
+  })};
+  if(it == nodes.end() || it->node != node) {
+    numa_process_memory entry{};
+    entry.node = node;
+    it = nodes.insert(it, entry);
+  }
+  return *it;
+}
+
+template<typename Callback>
+void for_each_numa_maps_token(std::string_view line, Callback &&callback) {
+  /// Call back with the key and value of each space separated token, such as "N0=12" or the bare "anon"
+  char const *it{line.data()};
+  char const *const end{it + line.size()};
+  while(it != end) {
+    it = procfs::skip_spaces(it, end);
+    char const *const token_begin{it};
+    while(it != end && *it != ' ') {
+      ++it;
+    }
+    std::string_view const token{token_begin, static_cast<size_t>(it - token_begin)};
+    auto const equals{token.find('=')};
+    if(equals == std::string_view::npos) {
+      callback(token, std::string_view{});
+    } else {
+      callback(token.substr(0, equals), token.substr(equals + 1));
+    }
+  }
+}
+#endif // defined(MEMORYSTORM_NUMA_SUPPORTED)
+
+}
+
+namespace detail {
+
+void parse_node_meminfo(std::string_view text, numa_node_memory &result) {
+  /// Parse lines of the form "Node 0 MemTotal:  5209848 kB"
+  #if defined(MEMORYSTORM_NUMA_SUPPORTED)
+    char const *it{text.data()};
+    char const *const end{it + text.size()};
+    while(it != end) {
+      char const *const line_end{std::find(it, end, '\n')};
+      for(unsigned int skip{0}; skip != 2; ++skip) {                            // "Node" and the node number
+        it = procfs::skip_spaces(it, line_end);
+        while(it != line_end && *it != ' ') {
+          ++it;
+        }
+      }
+      it = procfs::skip_spaces(it, line_end);
+      char const *const colon{std::find(it, line_end, ':')};
+      std::string_view const key{it, static_cast<size_t>(colon - it)};
+      for(auto const &entry : node_keys) {
+        if(entry.key == key) {
+          uint64_t value{0};
+          procfs::parse_uint(procfs::skip_spaces(colon + 1, line_end), line_end, value);
+          result.*entry.member = value * 1024;
+          break;
+        }
+      }
+      it = line_end == end ? end : line_end + 1;
+    }
+  #else
+    (void)text;
+    (void)result;
+  #endif // defined(MEMORYSTORM_NUMA_SUPPORTED)
+}
+
+void add_numa_maps_line(std::string_view line, uint64_t base_page_size, std::vector<numa_process_memory> &nodes) {
+  /// Add one /proc/self/numa_maps mapping's per-node page counts; the page size comes after the counts, so the line is read twice
+  #if defined(MEMORYSTORM_NUMA_SUPPORTED)
+    uint64_t page_size{base_page_size};
+    bool anonymous{false};
+    bool file{false};
+    bool huge{false};
+    for_each_numa_maps_token(line, [&](std::string_view key, std::string_view value){
+      if(key == "anon") {
+        anonymous = true;
+      } else if(key == "file") {
+        file = true;
+      } else if(key == "huge") {
+        huge = true;
+      } else if(key == "kernelpagesize_kB") {
+        procfs::parse_uint(value.data(), value.data() + value.size(), page_size);
+        page_size *= 1024;
+      }
+    });
+    huge = huge || page_size > base_page_size;
+    for_each_numa_maps_token(line, [&](std::string_view key, std::string_view value){
+      if(key.size() < 2 || key[0] != 'N' || key[1] < '0' || key[1] > '9') {
+        return;
+      }
+      uint64_t node{0};
+      uint64_t pages{0};
+      procfs::parse_uint(key.data() + 1, key.data() + key.size(), node);
+      procfs::parse_uint(value.data(), value.data() + value.size(), pages);
+      auto &entry{get_node_entry(nodes, static_cast<uint32_t>(node))};
+      uint64_t const bytes{pages * page_size};
+      entry.bytes += bytes;
+      if(anonymous) {
+        entry.anon_bytes += bytes;
+      } else if(file) {
+        entry.file_bytes += bytes;
+      }
+      if(huge) {
+        entry.huge_bytes += bytes;
+      }
+    });
+  #else
+    (void)line;
+    (void)base_page_size;
+    (void)nodes;
+  #endif // defined(MEMORYSTORM_NUMA_SUPPORTED)
+}
+
+}
+
+std::vector<uint32_t> get_numa_nodes() {
+  /// Online nodes, from a range list such as "0-3,5"; empty if the kernel has no NUMA support
+  std::vector<uint32_t> result;
+  #if defined(MEMORYSTORM_NUMA_SUPPORTED)
+    char buffer[256];
+    size_t const length{procfs::read_file(get_node_dirfd(), "online", buffer, sizeof(buffer))};
+    char const *it{buffer};
+    char const *const end{buffer + length};
+    while(it != end && *it >= '0' && *it <= '9') {
+      uint64_t first{0};
+      it = procfs::parse_uint(it, end, first);
+      uint64_t last{first};
+      if(it != end && *it == '-') {
+        it = procfs::parse_uint(it + 1, end, last);
+      }
+      for(uint64_t node{first}; node <= last; ++node) {
+        result.emplace_back(static_cast<uint32_t>(node));
+      }
+      if(it != end && *it == ',') {
+        ++it;
+      }
+    }
+  #endif // defined(MEMORYSTORM_NUMA_SUPPORTED)
+  return result;
+}
+
+std::vector<numa_node_memory> get_numa_meminfo() {
+  /// Memory of each online node
+  std::vector<numa_node_memory> result;
+  #if defined(MEMORYSTORM_NUMA_SUPPORTED)
+    for(uint32_t const node : get_numa_nodes()) {
+      char path[32]{"node"};
+      char *const number_end{std::to_chars(path + 4, path + 16, node).ptr};
+      std::memcpy(number_end, "/meminfo", sizeof("/meminfo"));
+      char buffer[4096];
+      size_t const length{procfs::read_file(get_node_dirfd(), path, buffer, sizeof(buffer))};
+      numa_node_memory memory{};
+      memory.node = node;
+      detail::parse_node_meminfo({buffer, length}, memory);
+      result.emplace_back(memory);
+    }
+  #endif // defined(MEMORYSTORM_NUMA_SUPPORTED)
+  return result;
+}
+
+std::vector<numa_process_memory> get_process_numa_memory() {
+  /// This process's resident memory on each node, summed over every mapping in /proc/self/numa_maps
+  std::vector<numa_process_memory> result;
+  #if defined(MEMORYSTORM_NUMA_SUPPORTED)
+    int const fd{open("/proc/self/numa_maps", O_RDONLY | O_CLOEXEC)};
+    if(fd < 0) {
+      return result;
+    }
+    uint64_t const base_page_size{static_cast<uint64_t>(sysconf(_SC_PAGESIZE))};
+    char buffer[16384];
+    procfs::for_each_line(fd, buffer, sizeof(buffer), [&](std::string_view line){
+      detail::add_numa_maps_line(line, base_page_size, result);
+    });
+    close(fd);
+  #endif // defined(MEMORYSTORM_NUMA_SUPPORTED)
+  return result;
+}
+
+std::vector<int32_t> get_page_nodes(void const *address, size_t length) {
+  /// The node each page of a range is on, or numa_page_absent if it isn't resident; queries move_pages without moving anything
+  std::vector<int32_t> result;
+  #if defined(MEMORYSTORM_MOVE_PAGES_SUPPORTED)
+    if(length == 0) {
+      return result;
+    }
+    uintptr_t const page_size{static_cast<uintptr_t>(sysconf(_SC_PAGESIZE))};
+    uintptr_t const start{reinterpret_cast<uintptr_t>(address) & ~(page_size - 1)};
+    uintptr_t const end{(reinterpret_cast<uintptr_t>(address) + length + page_size - 1) & ~(page_size - 1)};
+    size_t const count{(end - start) / page_size};
+    result.assign(count, numa_page_absent);
+    size_t constexpr chunk_pages{1024};
+    void *pages[chunk_pages];
+    int status[chunk_pages];
+    for(size_t first{0}; first < count; first += chunk_pages) {
+      size_t const chunk{std::min(chunk_pages, count - first)};
+      for(size_t i{0}; i != chunk; ++i) {
+        pages[i] = reinterpret_cast<void*>(start + (first + i) * page_size);
+      }
+      if(syscall(SYS_move_pages, 0, chunk, pages, nullptr, status, 0) != 0) {  // with no target nodes, move_pages only reports where each page is
+        continue;
+      }
+      for(size_t i{0}; i != chunk; ++i) {
+        if(status[i] >= 0) {
+          result[first + i] = status[i];
+        }
+      }
+    }
+  #else
+    (void)address;
+    (void)length;
+  #endif // defined(MEMORYSTORM_MOVE_PAGES_SUPPORTED)
+  return result;
+}
+
+}
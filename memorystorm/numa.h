@@ -0,0 +1,48 @@
+#pragma once
+
+/// Per-NUMA-node memory for the system and this process, and which node a buffer's pages are on (Linux)
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+struct numa_node_memory {
+  /// One node's memory in bytes, from /sys/devices/system/node/node<N>/meminfo
+  uint32_t node{0};
+  uint64_t total{0};
+  uint64_t free{0};
+  uint64_t used{0};
+  uint64_t file_pages{0};
+  uint64_t anon_pages{0};
+  uint64_t shmem{0};
+  uint64_t active_file{0};
+  uint64_t inactive_file{0};
+  uint64_t slab_reclaimable{0};
+};
+
+struct numa_process_memory {
+  /// This process's resident memory on one node, in bytes, from /proc/self/numa_maps
+  uint32_t node{0};
+  uint64_t bytes{0};
+  uint64_t anon_bytes{0};
+  uint64_t file_bytes{0};
+  uint64_t huge_bytes{0};                                                       // in mappings backed by huge pages
+};
+
+namespace detail {
+void parse_node_meminfo(std::string_view text, numa_node_memory &result);
+void add_numa_maps_line(std::string_view line, uint64_t base_page_size, std::vector<numa_process_memory> &nodes);
+}
+
+int32_t constexpr numa_page_absent{-1};                                         // get_page_nodes() result for a page that isn't resident
+
+std::vector<uint32_t> get_numa_nodes();
+std::vector<numa_node_memory> get_numa_meminfo();
+std::vector<numa_process_memory> get_process_numa_memory();
+std::vector<int32_t> get_page_nodes(void const *address, size_t length);
+
+}
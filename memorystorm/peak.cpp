@@ -0,0 +1,331 @@
+#include "peak.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "alloc_counters.h"
+#include "memorystorm.h"
+#include "platform_defines.h"
+#if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  #include <string_view>
+  #include "procfs.h"
+  #define MEMORYSTORM_HIGH_WATER_MARK_SUPPORTED
+#endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+
+namespace memorystorm {
+
+namespace {
+
+uint64_t read_high_water_mark() {
+  /// Peak RSS since the last reset, from VmHWM in /proc/self/status
+  uint64_t result{0};
+  #if defined(MEMORYSTORM_HIGH_WATER_MARK_SUPPORTED)
+    char buffer[4096];
+    size_t const length{procfs::read_file(AT_FDCWD, "/proc/self/status", buffer, sizeof(buffer))};
+    procfs::for_each_key_value(buffer, buffer + length, [&result](std::string_view key, uint64_t value){
+      if(key == "VmHWM") {
+        result = value * 1024;
+      }
+    });
+  #endif // defined(MEMORYSTORM_HIGH_WATER_MARK_SUPPORTED)
+  return result;
+}
+
+bool reset_high_water_mark() {
+  /// Reset VmHWM to the current RSS; needs Linux 4.0 or later
+  #if defined(MEMORYSTORM_HIGH_WATER_MARK_SUPPORTED)
+    int const fd{open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC)};
+    if(fd < 0) {
+      return false;
+    }
+    bool const written{write(fd, "5", 1) == 1};
+    close(fd);
+    return written;
+  #else
+    return false;
+  #endif // defined(MEMORYSTORM_HIGH_WATER_MARK_SUPPORTED)
+}
+
+std::atomic<bool> high_water_mark_reset_failed{false};                          // set once a reset fails, so later scopes sample instead of retrying
+
+bool high_water_mark_resettable() {
+  /// Whether clear_refs is writable; only probed, as writing to it is itself a reset and would disturb other readers of VmHWM
+  #if defined(MEMORYSTORM_HIGH_WATER_MARK_SUPPORTED)
+    static bool const resettable{access("/proc/self/clear_refs", W_OK) == 0};
+    return resettable && !high_water_mark_reset_failed.load(std::memory_order_relaxed);
+  #else
+    return false;
+  #endif // defined(MEMORYSTORM_HIGH_WATER_MARK_SUPPORTED)
+}
+
+peak_method resolve_method(peak_method method) {
+  /// Substitute what's available for what was asked for, falling back to sampling
+  if(method == peak_method::automatic) {
+    return get_default_peak_method();
+  }
+  if(method == peak_method::alloc_hooks && !alloc_hooks_installed()) {
+    return peak_method::sampling;
+  }
+  if(method == peak_method::high_water_mark && !high_water_mark_resettable()) {
+    return peak_method::sampling;
+  }
+  return method;
+}
+
+size_t get_bucket(uint64_t bytes) {
+  /// The number of significant bits, so each bucket covers a doubling
+  size_t bucket{0};
+  for(; bytes != 0; bytes >>= 1) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+}
+
+struct peak_registry {
+  /// Every active scope, so that resetting a shared peak first folds it into the scopes still measuring it
+  std::mutex mutex;
+  std::vector<peak_scope*> scopes;
+  size_t sampling_scopes{0};
+  std::chrono::nanoseconds interval{std::chrono::milliseconds{10}};
+  std::thread sampler;
+  std::condition_variable wake;
+  bool stop_requested{false};
+
+  ~peak_registry() {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      stop_requested = true;
+    }
+    wake.notify_all();
+    if(sampler.joinable()) {
+      sampler.join();
+    }
+  }
+
+  void fold(peak_method method, int64_t value, std::chrono::steady_clock::time_point taken = std::chrono::steady_clock::time_point::max()) {
+    /// Raise the observed peak of every active scope using a method; only scopes that began before a sample was taken
+    for(peak_scope *const scope : scopes) {
+      if(scope->method == method && (taken == std::chrono::steady_clock::time_point::max() || scope->start <= taken)) {
+        scope->observed = std::max(scope->observed, value);
+      }
+    }
+  }
+
+  void run() {
+    /// Shared sampling thread, idle whenever no sampling scope is active
+    std::unique_lock<std::mutex> lock{mutex};
+    while(!stop_requested) {
+      if(sampling_scopes == 0) {
+        wake.wait(lock, [this]{return stop_requested || sampling_scopes != 0;});
+        continue;
+      }
+      if(wake.wait_for(lock, interval, [this]{return stop_requested;})) {
+        break;
+      }
+      lock.unlock();
+      auto const taken{std::chrono::steady_clock::now()};
+      uint64_t const usage{get_physical_usage()};
+      lock.lock();
+      fold(peak_method::sampling, static_cast<int64_t>(usage), taken);
+    }
+  }
+};
+
+namespace {
+
+peak_registry &get_peak_registry() {
+  static peak_registry registry;
+  return registry;
+}
+
+}
+
+void peak_histogram::record(uint64_t bytes) {
+  /// Add one scope's peak increase
+  buckets[get_bucket(bytes)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(bytes, std::memory_order_relaxed);
+  uint64_t previous{max.load(std::memory_order_relaxed)};
+  while(bytes > previous && !max.compare_exchange_weak(previous, bytes, std::memory_order_relaxed)) {}
+}
+
+void peak_histogram::reset() {
+  /// Forget every recorded peak
+  for(auto &bucket : buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count.store(0, std::memory_order_relaxed);
+  total.store(0, std::memory_order_relaxed);
+  max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t peak_histogram::get_count() const {
+  /// Number of peaks recorded
+  return count.load(std::memory_order_relaxed);
+}
+
+uint64_t peak_histogram::get_max() const {
+  /// The largest peak increase recorded
+  return max.load(std::memory_order_relaxed);
+}
+
+double peak_histogram::get_mean() const {
+  /// Mean peak increase
+  uint64_t const recorded{count.load(std::memory_order_relaxed)};
+  return recorded == 0 ? 0.0 : static_cast<double>(total.load(std::memory_order_relaxed)) / static_cast<double>(recorded);
+}
+
+uint64_t peak_histogram::get_percentile(double percentile) const {
+  /// Upper bound of the bucket holding the given percentile, so within a factor of two above the true value, and never above the maximum
+  auto const counts{get_buckets()};
+  uint64_t recorded{0};
+  for(uint64_t const bucket : counts) {
+    recorded += bucket;
+  }
+  if(recorded == 0) {
+    return 0;
+  }
+  uint64_t const rank{std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(recorded))))};
+  uint64_t seen{0};
+  for(size_t i{0}; i != bucket_count; ++i) {
+    seen += counts[i];
+    if(seen >= rank) {
+      uint64_t const upper{i == 0 ? 0 : i == 64 ? UINT64_MAX : (uint64_t{1} << i) - 1};
+      return std::min(upper, get_max());
+    }
+  }
+  return get_max();
+}
+
+std::array<uint64_t, peak_histogram::bucket_count> peak_histogram::get_buckets() const {
+  /// Counts per bucket; bucket 0 holds zero increases and bucket i increases in [2^(i-1), 2^i)
+  std::array<uint64_t, bucket_count> result{};
+  for(size_t i{0}; i != bucket_count; ++i) {
+    result[i] = buckets[i].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+peak_scope::peak_scope(peak_histogram *this_histogram, peak_method this_method)
+  : histogram{this_histogram},
+    method{resolve_method(this_method)},
+    start{std::chrono::steady_clock::now()} {
+  auto &registry{get_peak_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  switch(method) {
+  case peak_method::alloc_hooks:
+    detail::peak_tracking.fetch_add(1, std::memory_order_relaxed);
+    registry.fold(method, detail::peak_live_max.load(std::memory_order_relaxed));
+    origin = detail::peak_live_bytes.load(std::memory_order_relaxed);
+    detail::peak_live_max.store(origin, std::memory_order_relaxed);
+    observed = origin;
+    baseline = get_alloc_stats().live_bytes();
+    break;
+  case peak_method::high_water_mark:
+    registry.fold(method, static_cast<int64_t>(read_high_water_mark()));
+    if(reset_high_water_mark()) {
+      baseline = get_physical_usage();
+      observed = static_cast<int64_t>(baseline);
+      break;
+    }
+    high_water_mark_reset_failed.store(true, std::memory_order_relaxed);        // VmHWM still holds an older peak, so sample this scope instead
+    method = peak_method::sampling;
+    [[fallthrough]];
+  default:
+    baseline = get_physical_usage();
+    observed = static_cast<int64_t>(baseline);
+    ++registry.sampling_scopes;
+    if(!registry.sampler.joinable()) {
+      registry.sampler = std::thread{&peak_registry::run, &registry};
+    }
+    registry.wake.notify_all();
+    break;
+  }
+  registry.scopes.emplace_back(this);
+}
+
+peak_scope::~peak_scope() {
+  finish();
+}
+
+int64_t peak_scope::read_peak() const {
+  /// The peak so far, in the method's units; the registry must be locked
+  switch(method) {
+  case peak_method::alloc_hooks:
+    return std::max(observed, detail::peak_live_max.load(std::memory_order_relaxed));
+  case peak_method::high_water_mark:
+    return std::max(observed, static_cast<int64_t>(read_high_water_mark()));
+  default:
+    return std::max(observed, static_cast<int64_t>(get_physical_usage()));
+  }
+}
+
+peak_usage peak_scope::make_usage(int64_t peak) const {
+  /// Convert a peak reading to bytes
+  peak_usage usage{};
+  usage.method = method;
+  usage.baseline = baseline;
+  if(method == peak_method::alloc_hooks) {
+    usage.peak = baseline + static_cast<uint64_t>(std::max<int64_t>(peak - origin, 0));
+  } else {
+    usage.peak = std::max(baseline, static_cast<uint64_t>(peak));
+  }
+  usage.duration = std::chrono::steady_clock::now() - start;
+  return usage;
+}
+
+peak_method peak_scope::get_method() const {
+  /// The method actually in use, after substituting for unavailable ones
+  return method;
+}
+
+peak_usage peak_scope::current() const {
+  /// Baseline and peak so far, or the final figures once finished
+  auto &registry{get_peak_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  return finished ? result : make_usage(read_peak());
+}
+
+peak_usage peak_scope::finish() {
+  /// Stop measuring early and record the peak increase in the histogram; later calls return the same figures
+  auto &registry{get_peak_registry()};
+  {
+    std::lock_guard<std::mutex> lock{registry.mutex};
+    if(finished) {
+      return result;
+    }
+    result = make_usage(read_peak());
+    finished = true;
+    registry.scopes.erase(std::find(registry.scopes.begin(), registry.scopes.end(), this));
+    if(method == peak_method::alloc_hooks) {
+      detail::peak_tracking.fetch_sub(1, std::memory_order_relaxed);
+    } else if(method == peak_method::sampling) {
+      --registry.sampling_scopes;
+    }
+  }
+  if(histogram) {
+    histogram->record(result.increase());
+  }
+  return result;
+}
+
+peak_method get_default_peak_method() {
+  /// The method automatic resolves to: exact heap peaks if the hooks are linked in, then VmHWM, then sampling
+  if(alloc_hooks_installed()) {
+    return peak_method::alloc_hooks;
+  }
+  return high_water_mark_resettable() ? peak_method::high_water_mark : peak_method::sampling;
+}
+
+void set_peak_sampling_interval(std::chrono::nanoseconds interval) {
+  /// How often the shared thread samples RSS for scopes using the sampling method; 10ms by default
+  auto &registry{get_peak_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  registry.interval = interval;
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/// Peak memory over a region of code, and a histogram of those peaks for sizing concurrency
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace memorystorm {
+
+enum class peak_method : uint8_t {
+  automatic,                                                                    // the best available of the methods below
+  alloc_hooks,                                                                  // live heap bytes, exact, if the allocation hooks are linked in; while active, every allocation updates one shared counter, contended under many threads
+  high_water_mark,                                                              // RSS from VmHWM, reset through /proc/self/clear_refs (Linux)
+  sampling                                                                      // RSS sampled on a shared background thread
+};
+
+struct peak_usage {
+  /// Baseline and peak over a scope, in RSS bytes, or live heap bytes with the alloc_hooks method
+  peak_method method{peak_method::automatic};
+  uint64_t baseline{0};
+  uint64_t peak{0};
+  std::chrono::nanoseconds duration{0};
+
+  uint64_t increase() const {
+    return peak > baseline ? peak - baseline : 0;
+  }
+};
+
+class peak_histogram {
+  /// Thread-safe log2 histogram of the peak increase of each finished scope
+public:
+  static size_t constexpr bucket_count{65};                                    // bucket 0 holds zero, bucket i holds [2^(i-1), 2^i)
+
+private:
+  std::array<std::atomic<uint64_t>, bucket_count> buckets{};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> max{0};
+
+public:
+  void record(uint64_t bytes);
+  void reset();
+
+  uint64_t get_count() const;
+  uint64_t get_max() const;
+  double get_mean() const;
+  uint64_t get_percentile(double percentile) const;
+  std::array<uint64_t, bucket_count> get_buckets() const;
+};
+
+class peak_scope {
+  /// RAII measurement of peak memory from construction to destruction or finish(); scopes may nest and overlap across threads
+  peak_histogram *const histogram;
+  peak_method method;                                                           // const after construction, which may fall back to sampling
+  std::chrono::steady_clock::time_point const start;
+  uint64_t baseline{0};
+  int64_t origin{0};                                                            // alloc_hooks: the shared heap counter when the scope began
+  int64_t observed{0};                                                          // highest reading folded in before a shared reset
+  bool finished{false};
+  peak_usage result{};
+
+  friend struct peak_registry;
+
+  int64_t read_peak() const;
+  peak_usage make_usage(int64_t peak) const;
+
+public:
+  explicit peak_scope(peak_histogram *histogram = nullptr, peak_method method = peak_method::automatic);
+  peak_scope(peak_scope const&) = delete;
+  peak_scope &operator=(peak_scope const&) = delete;
+  ~peak_scope();
+
+  peak_method get_method() const;
+  peak_usage current() const;
+  peak_usage finish();
+};
+
+peak_method get_default_peak_method();
+void set_peak_sampling_interval(std::chrono::nanoseconds interval);
+
+}
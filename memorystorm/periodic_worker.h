@@ -0,0 +1,73 @@
+#pragma once
+
+/// Internal helper running a task on a background thread at a fixed interval, until stopped
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace memorystorm {
+namespace detail {
+
+class periodic_worker {
+  /// Calls a task every interval on its own thread; stopping wakes the thread rather than waiting out the interval
+  std::thread worker;
+  std::mutex worker_mutex;
+  std::condition_variable worker_wake;
+  bool stop_requested{false};
+
+  void run(std::chrono::nanoseconds interval, std::function<void()> const &task) {
+    /// Periodic loop, with the lock released while the task runs
+    std::unique_lock<std::mutex> lock{worker_mutex};
+    while(!worker_wake.wait_for(lock, interval, [this]{return stop_requested;})) {
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+public:
+  periodic_worker() = default;
+  periodic_worker(periodic_worker const&) = delete;
+  periodic_worker &operator=(periodic_worker const&) = delete;
+  ~periodic_worker() {
+    stop();
+  }
+
+  bool start(std::chrono::nanoseconds interval, std::function<void()> task) {
+    /// Start calling the task; returns false if already running
+    if(worker.joinable()) {
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> lock{worker_mutex};
+      stop_requested = false;
+    }
+    worker = std::thread{[this, interval, this_task = std::move(task)]{ run(interval, this_task); }};
+    return true;
+  }
+
+  void stop() {
+    /// Stop and join the thread, if running
+    if(!worker.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock{worker_mutex};
+      stop_requested = true;
+    }
+    worker_wake.notify_all();
+    worker.join();
+  }
+
+  bool running() const {
+    /// Whether the thread is active
+    return worker.joinable();
+  }
+};
+
+}
+}
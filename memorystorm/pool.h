@@ -0,0 +1,142 @@
+#pragma once
+
+/// Fixed-size free list allocator, for many objects of one type with unpredictable lifetimes
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "resource.h"
+
+namespace memorystorm {
+
+template<typename T>
+class pool : public tracked_resource {
+  /// Not thread safe; serves any request that fits in a T from the free list and passes larger ones upstream
+  union chunk {
+    chunk *next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+  struct block {
+    block *next;
+  };
+  static size_t constexpr header_size{(sizeof(block) + alignof(chunk) - 1) / alignof(chunk) * alignof(chunk)};
+
+  std::pmr::memory_resource *const upstream;
+  size_t const chunks_per_block;
+  block *blocks{nullptr};
+  chunk *free_list{nullptr};
+
+  size_t get_block_size() const {
+    return header_size + chunks_per_block * sizeof(chunk);
+  }
+
+  static bool fits(size_t bytes, size_t alignment) {
+    return bytes <= sizeof(chunk) && alignment <= alignof(chunk);
+  }
+
+  void grow() {
+    /// Carve a new upstream block into chunks and push them onto the free list
+    size_t const size{get_block_size()};
+    if(!try_reserve(size)) {
+      throw std::bad_alloc{};
+    }
+    void *memory{nullptr};
+    try {
+      memory = upstream->allocate(size, alignof(chunk) > alignof(block) ? alignof(chunk) : alignof(block));
+    } catch(...) {
+      unreserve(size);
+      throw;
+    }
+    blocks = new(memory) block{blocks};
+    chunk *const chunks{reinterpret_cast<chunk*>(static_cast<char*>(memory) + header_size)};
+    for(size_t i{chunks_per_block}; i != 0; --i) {
+      chunks[i - 1].next = free_list;
+      free_list = &chunks[i - 1];
+    }
+  }
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    if(!fits(bytes, alignment)) {
+      if(!try_reserve(bytes)) {
+        throw std::bad_alloc{};
+      }
+      try {
+        void *const pointer{upstream->allocate(bytes, alignment)};
+        add_used(bytes);
+        return pointer;
+      } catch(...) {
+        unreserve(bytes);
+        throw;
+      }
+    }
+    if(!free_list) {
+      grow();
+    }
+    chunk *const result{free_list};
+    free_list = result->next;
+    add_used(sizeof(chunk));
+    return result;
+  }
+
+  void do_deallocate(void *pointer, size_t bytes, size_t alignment) override {
+    if(!fits(bytes, alignment)) {
+      upstream->deallocate(pointer, bytes, alignment);
+      sub_used(bytes);
+      unreserve(bytes);
+      return;
+    }
+    chunk *const freed{static_cast<chunk*>(pointer)};
+    freed->next = free_list;
+    free_list = freed;
+    sub_used(sizeof(chunk));
+  }
+
+  bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+
+public:
+  explicit pool(std::string this_name,
+                uint64_t this_budget = unlimited,
+                size_t this_chunks_per_block = 64,
+                std::pmr::memory_resource *this_upstream = std::pmr::get_default_resource())
+    : tracked_resource{std::move(this_name), this_budget},
+      upstream{this_upstream},
+      chunks_per_block{this_chunks_per_block == 0 ? 1 : this_chunks_per_block} {
+  }
+
+  ~pool() override {
+    /// Return every block upstream; objects still alive are not destroyed
+    size_t const size{get_block_size()};
+    while(blocks) {
+      block *const next{blocks->next};
+      upstream->deallocate(blocks, size, alignof(chunk) > alignof(block) ? alignof(chunk) : alignof(block));
+      unreserve(size);
+      blocks = next;
+    }
+  }
+
+  template<typename... Args>
+  T *create(Args &&...args) {
+    /// Allocate and construct one object
+    void *const memory{allocate(sizeof(T), alignof(T))};
+    try {
+      return new(memory) T(std::forward<Args>(args)...);
+    } catch(...) {
+      deallocate(memory, sizeof(T), alignof(T));
+      throw;
+    }
+  }
+
+  void destroy(T *object) {
+    /// Destroy an object made by create() and return its chunk to the free list
+    if(!object) {
+      return;
+    }
+    object->~T();
+    deallocate(object, sizeof(T), alignof(T));
+  }
+};
+
+}
@@ -0,0 +1,248 @@
+#include "pressure.h"
+#include "platform_defines.h"
+#if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  #include <cerrno>
+  #include <cstdio>
+  #include <string_view>
+  #include <poll.h>
+  #include <sys/eventfd.h>
+  #include "cgroup.h"
+  #include "procfs.h"
+  #define MEMORYSTORM_PRESSURE_SUPPORTED
+#endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+
+namespace memorystorm {
+
+namespace {
+
+#if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+char const *parse_percentage(char const *it, char const *end, double &value) {
+  /// Parse a fixed-point percentage such as "12.34" without going through the locale-dependent strtod
+  uint64_t whole{0};
+  it = procfs::parse_uint(it, end, whole);
+  double fraction{0.0};
+  if(it != end && *it == '.') {
+    double scale{0.1};
+    for(++it; it != end && *it >= '0' && *it <= '9'; ++it) {
+      fraction += (*it - '0') * scale;
+      scale *= 0.1;
+    }
+  }
+  value = static_cast<double>(whole) + fraction;
+  return it;
+}
+
+void parse_pressure_line(char const *it, char const *end, pressure_stats::line &line) {
+  /// Parse "avg10=0.00 avg60=0.00 avg300=0.00 total=0" after the leading some/full word
+  while(it != end && *it != '\n') {
+    it = procfs::skip_spaces(it, end);
+    char const *const key{it};
+    while(it != end && *it != '=' && *it != '\n') {
+      ++it;
+    }
+    if(it == end || *it != '=') {
+      break;
+    }
+    std::string_view const name{key, static_cast<size_t>(it - key)};
+    ++it;
+    if(name == "total") {
+      uint64_t total{0};
+      it = procfs::parse_uint(it, end, total);
+      line.total = std::chrono::microseconds{total};
+    } else {
+      double value{0.0};
+      it = parse_percentage(it, end, value);
+      if(name == "avg10") {
+        line.avg10 = value;
+      } else if(name == "avg60") {
+        line.avg60 = value;
+      } else if(name == "avg300") {
+        line.avg300 = value;
+      }
+    }
+  }
+}
+#endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+
+}
+
+std::string get_memory_pressure_path() {
+  /// The pressure file for this process's cgroup if it has one, otherwise the system-wide file
+  #if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+    if(get_cgroup_version() == cgroup_version::v2) {
+      std::string const cgroup_pressure{get_cgroup_path() + "/memory.pressure"};
+      if(access(cgroup_pressure.c_str(), R_OK) == 0) {
+        return cgroup_pressure;
+      }
+    }
+    if(access("/proc/pressure/memory", R_OK) == 0) {
+      return "/proc/pressure/memory";
+    }
+  #endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+  return {};
+}
+
+pressure_stats get_memory_pressure(std::string const &path) {
+  /// Read the current stall averages; all zero if PSI is unavailable
+  pressure_stats result{};
+  #if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+    if(path.empty()) {
+      return result;
+    }
+    char buffer[256];
+    size_t const length{procfs::read_file(AT_FDCWD, path.c_str(), buffer, sizeof(buffer))};
+    char const *const end{buffer + length};
+    char const *it{buffer};
+    while(it != end) {
+      std::string_view const rest{it, static_cast<size_t>(end - it)};
+      if(rest.compare(0, 4, "some") == 0) {
+        parse_pressure_line(it + 4, end, result.some);
+      } else if(rest.compare(0, 4, "full") == 0) {
+        parse_pressure_line(it + 4, end, result.full);
+      }
+      while(it != end && *it++ != '\n') {}
+    }
+  #else
+    (void)path;
+  #endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+  return result;
+}
+
+pressure_monitor::pressure_monitor(std::string this_path)
+  : path{std::move(this_path)} {
+}
+
+pressure_monitor::~pressure_monitor() {
+  stop();
+  #if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+    for(auto const &this_trigger : triggers) {
+      close(this_trigger.fd);
+    }
+  #endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+}
+
+bool pressure_monitor::add_trigger(pressure_kind kind,
+                                   std::chrono::microseconds stall,
+                                   std::chrono::microseconds window,
+                                   callback function) {
+  /// Register a trigger that fires when tasks stall for more than stall within any window; only while stopped
+  #if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+    if(running() || path.empty()) {
+      return false;
+    }
+    int const fd{open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC)};
+    if(fd < 0) {
+      return false;
+    }
+    char request[64];
+    int const length{std::snprintf(request, sizeof(request), "%s %lld %lld",
+                                   kind == pressure_kind::some ? "some" : "full",
+                                   static_cast<long long>(stall.count()),
+                                   static_cast<long long>(window.count()))};
+    if(write(fd, request, static_cast<size_t>(length) + 1) < 0) {               // the kernel expects the terminating null; fails without CAP_SYS_RESOURCE for windows that aren't a multiple of 2s
+      close(fd);
+      return false;
+    }
+    triggers.emplace_back(trigger{fd, kind, stall, window, std::move(function)});
+    return true;
+  #else
+    (void)kind;
+    (void)stall;
+    (void)window;
+    (void)function;
+    return false;
+  #endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+}
+
+void pressure_monitor::run() {
+  /// Block in poll until a trigger fires or we're asked to stop; on an error the thread exits and running() turns false
+  #if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+    struct deactivate {
+      std::atomic<bool> &flag;
+      ~deactivate() {
+        flag.store(false, std::memory_order_release);
+      }
+    } const on_exit{active};
+    std::vector<pollfd> fds;
+    fds.reserve(triggers.size() + 1);
+    for(auto const &this_trigger : triggers) {
+      fds.emplace_back(pollfd{this_trigger.fd, POLLPRI, 0});
+    }
+    fds.emplace_back(pollfd{wake_fd, POLLIN, 0});
+    while(!stop_requested.load(std::memory_order_acquire)) {
+      if(poll(fds.data(), fds.size(), -1) < 0) {
+        if(errno == EINTR) {
+          continue;
+        }
+        return;
+      }
+      for(size_t i{0}; i != triggers.size(); ++i) {
+        if(fds[i].revents & (POLLERR | POLLNVAL)) {
+          return;                                                               // the monitored cgroup has gone away
+        }
+        if(fds[i].revents & POLLPRI) {
+          auto const &this_trigger{triggers[i]};
+          if(this_trigger.function) {
+            this_trigger.function(this_trigger.kind, this_trigger.stall, this_trigger.window);
+          }
+        }
+      }
+    }
+  #endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+}
+
+bool pressure_monitor::start() {
+  /// Start the notification thread; returns false if there's nothing to wait for
+  #if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+    if(running()) {
+      return true;
+    }
+    stop();                                                                     // join a thread that exited on an error
+    if(triggers.empty()) {
+      return false;
+    }
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(wake_fd < 0) {
+      return false;
+    }
+    stop_requested.store(false, std::memory_order_release);
+    active.store(true, std::memory_order_release);
+    worker = std::thread{&pressure_monitor::run, this};
+    return true;
+  #else
+    return false;
+  #endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+}
+
+void pressure_monitor::stop() {
+  /// Wake and join the notification thread
+  #if defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+    if(!worker.joinable()) {
+      return;
+    }
+    stop_requested.store(true, std::memory_order_release);
+    uint64_t const one{1};
+    ssize_t const written{write(wake_fd, &one, sizeof(one))};                   // wake poll so the thread notices the stop request
+    (void)written;
+    worker.join();
+    close(wake_fd);
+    wake_fd = -1;
+  #endif // defined(MEMORYSTORM_PRESSURE_SUPPORTED)
+}
+
+bool pressure_monitor::running() const {
+  /// Whether the notification thread is active; false once it has stopped on an error such as the cgroup being removed
+  return active.load(std::memory_order_acquire);
+}
+
+std::string const &pressure_monitor::get_path() const {
+  /// The pressure file being monitored, empty if PSI is unavailable
+  return path;
+}
+
+pressure_stats pressure_monitor::current() const {
+  /// Current stall averages for the monitored pressure file
+  return get_memory_pressure(path);
+}
+
+}
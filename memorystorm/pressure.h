@@ -0,0 +1,76 @@
+#pragma once
+
+/// Memory pressure stall information (PSI) and event-driven notification of pressure thresholds on Linux
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace memorystorm {
+
+enum class pressure_kind {
+  some,                                                                         // at least one task stalled on memory
+  full                                                                          // all non-idle tasks stalled on memory at once
+};
+
+struct pressure_stats {
+  /// Percentage of wall time spent stalled over the last 10, 60 and 300 seconds, plus the total stall time
+  struct line {
+    double avg10{0.0};
+    double avg60{0.0};
+    double avg300{0.0};
+    std::chrono::microseconds total{0};
+  };
+  line some{};
+  line full{};
+};
+
+std::string get_memory_pressure_path();
+pressure_stats get_memory_pressure(std::string const &path = get_memory_pressure_path());
+
+class pressure_monitor {
+  /// Registers PSI triggers and waits for them on one thread, calling back when a stall threshold is crossed
+public:
+  using callback = std::function<void(pressure_kind kind, std::chrono::microseconds stall, std::chrono::microseconds window)>;
+
+private:
+  struct trigger {
+    int fd{-1};
+    pressure_kind kind{pressure_kind::some};
+    std::chrono::microseconds stall{0};
+    std::chrono::microseconds window{0};
+    callback function;
+  };
+
+  std::string const path;
+  std::vector<trigger> triggers;
+  std::thread worker;
+  int wake_fd{-1};
+  std::atomic<bool> stop_requested{false};
+  std::atomic<bool> active{false};                                              // cleared when the thread exits, including on error
+
+  void run();
+
+public:
+  explicit pressure_monitor(std::string path = get_memory_pressure_path());
+  pressure_monitor(pressure_monitor const&) = delete;
+  pressure_monitor &operator=(pressure_monitor const&) = delete;
+  ~pressure_monitor();
+
+  bool add_trigger(pressure_kind kind,
+                   std::chrono::microseconds stall,
+                   std::chrono::microseconds window,
+                   callback function);
+
+  bool start();
+  void stop();
+  bool running() const;
+
+  std::string const &get_path() const;
+  pressure_stats current() const;
+};
+
+}
@@ -0,0 +1,264 @@
+#include "process.h"
+#include <algorithm>
+#include "platform_defines.h"
+#if defined(PLATFORM_WINDOWS)
+  #include <windows.h>
+#elif defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  #include <charconv>
+  #include <string_view>
+  #include <dirent.h>
+  #include "procfs.h"
+  #define MEMORYSTORM_PROCESS_SUPPORTED
+#else
+  #include <unistd.h>
+#endif // platform selection
+
+namespace memorystorm {
+
+namespace {
+
+#if defined(MEMORYSTORM_PROCESS_SUPPORTED)
+int get_proc_dirfd() {
+  /// /proc opened once, so each per-process file is a single openat with a short relative path
+  static int const fd{open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC)};       // the same for every process, so safe to keep across forks
+  return fd;
+}
+
+uint64_t get_page_size() {
+  static uint64_t const page_size{static_cast<uint64_t>(sysconf(_SC_PAGESIZE))};
+  return page_size;
+}
+
+class proc_path {
+  /// A path such as "<pid>/statm", built in place without allocating
+  char path[96];
+  char *it{path};
+  char *const end{path + sizeof(path) - 1};
+
+public:
+  proc_path(uint32_t pid, std::string_view name) {
+    append(pid).append(name);
+  }
+  proc_path(proc_path const&) = delete;
+  proc_path &operator=(proc_path const&) = delete;
+  proc_path &append(uint32_t value) {
+    it = std::to_chars(it, end, value).ptr;
+    *it = '\0';
+    return *this;
+  }
+  proc_path &append(std::string_view text) {
+    size_t const length{std::min(text.size(), static_cast<size_t>(end - it))};
+    it = std::copy(text.data(), text.data() + length, it);
+    *it = '\0';
+    return *this;
+  }
+  char const *c_str() const {
+    return path;
+  }
+};
+
+bool read_process(int proc_fd, uint32_t pid, uint32_t fields, process_memory &result) {
+  /// Read the requested fields for one process into stack buffers
+  result = process_memory{};
+  result.pid = pid;
+  {
+    char buffer[128];
+    size_t const length{procfs::read_file(proc_fd, proc_path{pid, "/statm"}.c_str(), buffer, sizeof(buffer))};
+    if(length == 0) {
+      return false;                                                             // gone, or not ours to read
+    }
+    char const *const end{buffer + length};
+    uint64_t size{0};
+    uint64_t resident{0};
+    char const *it{procfs::parse_uint(buffer, end, size)};
+    procfs::parse_uint(procfs::skip_spaces(it, end), end, resident);
+    result.vsz = size * get_page_size();
+    result.rss = resident * get_page_size();
+  }
+  if(fields & process_field::pss) {
+    char buffer[4096];
+    size_t const length{procfs::read_file(proc_fd, proc_path{pid, "/smaps_rollup"}.c_str(), buffer, sizeof(buffer))};
+    procfs::for_each_key_value(buffer, buffer + length, [&](std::string_view key, uint64_t value){
+      if(key == "Pss") {
+        result.pss = value * 1024;
+      } else if(key == "Swap") {
+        result.swap = value * 1024;
+      }
+    });
+  } else if(fields & process_field::swap) {
+    char buffer[4096];
+    size_t const length{procfs::read_file(proc_fd, proc_path{pid, "/status"}.c_str(), buffer, sizeof(buffer))};
+    procfs::for_each_key_value(buffer, buffer + length, [&](std::string_view key, uint64_t value){
+      if(key == "VmSwap") {
+        result.swap = value * 1024;
+      }
+    });
+  }
+  result.valid = true;
+  return true;
+}
+
+template<typename Callback>
+void for_each_entry(int dirfd, char const *name, Callback &&callback) {
+  /// Call back with each numeric entry of a directory relative to dirfd
+  int const fd{openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+  if(fd < 0) {
+    return;
+  }
+  DIR *const directory{fdopendir(fd)};
+  if(!directory) {
+    close(fd);
+    return;
+  }
+  while(dirent const *entry{readdir(directory)}) {
+    uint64_t value{0};
+    char const *const end{entry->d_name + std::char_traits<char>::length(entry->d_name)};
+    if(entry->d_name[0] != '\0' && procfs::parse_uint(entry->d_name, end, value) == end) {
+      callback(static_cast<uint32_t>(value));
+    }
+  }
+  closedir(directory);
+}
+
+bool read_children(int proc_fd, uint32_t pid, std::vector<uint32_t> &children) {
+  /// Append a process's direct children from each thread's children file; false if the kernel lacks CONFIG_PROC_CHILDREN
+  bool supported{false};
+  for_each_entry(proc_fd, proc_path{pid, "/task"}.c_str(), [&](uint32_t tid){
+    char buffer[4096];
+    proc_path path{pid, "/task/"};
+    path.append(tid).append("/children");
+    int const fd{openat(proc_fd, path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if(fd < 0) {
+      return;
+    }
+    supported = true;
+    procfs::for_each_line(fd, buffer, sizeof(buffer), [&](std::string_view line){
+      char const *cursor{line.data()};
+      char const *const end{cursor + line.size()};
+      while((cursor = procfs::skip_spaces(cursor, end)) != end) {
+        uint64_t child{0};
+        char const *const next{procfs::parse_uint(cursor, end, child)};
+        if(next == cursor) {
+          break;
+        }
+        children.emplace_back(static_cast<uint32_t>(child));
+        cursor = next;
+      }
+    });
+    close(fd);
+  });
+  return supported;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> read_all_parents(int proc_fd) {
+  /// Fallback for kernels without children files: (parent, pid) for every process, from each stat file
+  std::vector<std::pair<uint32_t, uint32_t>> result;
+  for_each_entry(proc_fd, ".", [&](uint32_t pid){
+    char buffer[512];
+    size_t const length{procfs::read_file(proc_fd, proc_path{pid, "/stat"}.c_str(), buffer, sizeof(buffer))};
+    std::string_view const stat{buffer, length};
+    auto const name_end{stat.rfind(')')};                                       // the command name may contain spaces and brackets
+    if(name_end == std::string_view::npos || name_end + 4 >= stat.size()) {
+      return;
+    }
+    char const *const end{buffer + length};
+    uint64_t parent{0};
+    procfs::parse_uint(buffer + name_end + 4, end, parent);                     // skip ") S "
+    result.emplace_back(static_cast<uint32_t>(parent), pid);
+  });
+  std::sort(result.begin(), result.end());
+  return result;
+}
+#endif // defined(MEMORYSTORM_PROCESS_SUPPORTED)
+
+}
+
+uint32_t get_current_process_id() {
+  /// This process's ID
+  #if defined(PLATFORM_WINDOWS)
+    return static_cast<uint32_t>(GetCurrentProcessId());
+  #else
+    return static_cast<uint32_t>(getpid());
+  #endif // defined(PLATFORM_WINDOWS)
+}
+
+std::vector<uint32_t> get_process_tree(uint32_t root) {
+  /// A process followed by all of its descendants, breadth first; empty if the root doesn't exist
+  std::vector<uint32_t> result;
+  #if defined(MEMORYSTORM_PROCESS_SUPPORTED)
+    int const proc_fd{get_proc_dirfd()};
+    if(proc_fd < 0 || faccessat(proc_fd, proc_path{root, "/statm"}.c_str(), R_OK, 0) != 0) {
+      return result;
+    }
+    result.emplace_back(root);
+    std::vector<std::pair<uint32_t, uint32_t>> parents;
+    bool use_children{true};
+    for(size_t index{0}; index != result.size(); ++index) {
+      uint32_t const pid{result[index]};
+      if(use_children && !read_children(proc_fd, pid, result)) {
+        use_children = false;
+        parents = read_all_parents(proc_fd);
+      }
+      if(!use_children) {
+        auto it{std::lower_bound(parents.begin(), parents.end(), std::make_pair(pid, uint32_t{0}))};
+        for(; it != parents.end() && it->first == pid; ++it) {
+          result.emplace_back(it->second);
+        }
+      }
+    }
+  #else
+    (void)root;
+  #endif // defined(MEMORYSTORM_PROCESS_SUPPORTED)
+  return result;
+}
+
+process_memory get_process_memory(uint32_t pid, uint32_t fields) {
+  /// Memory of one process
+  process_memory result{};
+  result.pid = pid;
+  #if defined(MEMORYSTORM_PROCESS_SUPPORTED)
+    read_process(get_proc_dirfd(), pid, fields, result);
+  #else
+    (void)fields;
+  #endif // defined(MEMORYSTORM_PROCESS_SUPPORTED)
+  return result;
+}
+
+process_group_memory get_process_memory(std::vector<uint32_t> const &pids, uint32_t fields) {
+  /// Memory of each listed process, plus totals
+  process_group_memory result;
+  result.processes.reserve(pids.size());
+  for(uint32_t const pid : pids) {
+    result.processes.emplace_back(get_process_memory(pid, fields));
+    auto const &process{result.processes.back()};
+    if(process.valid) {
+      result.total.valid = true;
+      result.total.rss  += process.rss;
+      result.total.pss  += process.pss;
+      result.total.vsz  += process.vsz;
+      result.total.swap += process.swap;
+    }
+  }
+  return result;
+}
+
+process_group_memory get_process_tree_memory(uint32_t root, uint32_t fields) {
+  /// Memory of a process and all its descendants, plus totals
+  return get_process_memory(get_process_tree(root), fields);
+}
+
+std::vector<process_memory> get_top_processes(std::vector<uint32_t> const &pids, size_t count, uint32_t fields) {
+  /// The count listed processes using the most resident memory, largest first
+  std::vector<process_memory> result{get_process_memory(pids, fields).processes};
+  result.erase(std::remove_if(result.begin(), result.end(), [](process_memory const &process){
+    return !process.valid;
+  }), result.end());
+  count = std::min(count, result.size());
+  std::partial_sort(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(count), result.end(), [](process_memory const &lhs, process_memory const &rhs){
+    return lhs.rss > rhs.rss;
+  });
+  result.resize(count);
+  return result;
+}
+
+}
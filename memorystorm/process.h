@@ -0,0 +1,46 @@
+#pragma once
+
+/// Memory usage of other processes, lists of processes and process trees (Linux)
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+namespace process_field {
+uint32_t constexpr rss{ 1u << 0};                                               // from statm, cheap
+uint32_t constexpr vsz{ 1u << 1};                                               // from statm, cheap
+uint32_t constexpr swap{1u << 2};                                               // from status
+uint32_t constexpr pss{ 1u << 3};                                               // from smaps_rollup, which walks every mapping; also fills swap
+uint32_t constexpr basic{rss | vsz | swap};
+uint32_t constexpr all{basic | pss};
+}
+
+struct process_memory {
+  /// One process's memory in bytes; valid is false if it couldn't be read, e.g. because it has exited
+  uint32_t pid{0};
+  bool valid{false};
+  uint64_t rss{0};
+  uint64_t pss{0};
+  uint64_t vsz{0};
+  uint64_t swap{0};
+};
+
+struct process_group_memory {
+  /// Per-process figures plus totals over the valid entries; summed RSS counts shared pages more than once, summed PSS doesn't
+  std::vector<process_memory> processes;
+  process_memory total{};
+};
+
+uint32_t get_current_process_id();
+std::vector<uint32_t> get_process_tree(uint32_t root = get_current_process_id());
+
+process_memory get_process_memory(uint32_t pid, uint32_t fields = process_field::basic);
+process_group_memory get_process_memory(std::vector<uint32_t> const &pids, uint32_t fields = process_field::basic);
+process_group_memory get_process_tree_memory(uint32_t root = get_current_process_id(), uint32_t fields = process_field::basic);
+
+std::vector<process_memory> get_top_processes(std::vector<uint32_t> const &pids, size_t count, uint32_t fields = process_field::rss);
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/// Internal helpers for reading and parsing small kernel pseudo-files without allocating
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace memorystorm {
+namespace procfs {
+
+inline char const *parse_uint(char const *it, char const *end, uint64_t &value) {
+  /// Parse an unsigned decimal integer, stopping at the first non-digit
+  uint64_t result{0};
+  for(unsigned int digit; it != end && (digit = static_cast<unsigned int>(static_cast<unsigned char>(*it) - '0')) < 10u; ++it) {
+    result = result * 10u + digit;
+  }
+  value = result;
+  return it;
+}
+
+inline char const *skip_spaces(char const *it, char const *end) {
+  /// Advance past spaces and tabs
+  while(it != end && (*it == ' ' || *it == '\t')) {
+    ++it;
+  }
+  return it;
+}
+
+inline size_t read_fd(int fd, char *buffer, size_t size) {
+  /// Read as much of an open pseudo-file as fits, from offset zero; returns the number of bytes read
+  size_t total{0};
+  while(total != size) {
+    size_t const wanted{size - total};
+    ssize_t const length{pread(fd, buffer + total, wanted, static_cast<off_t>(total))};
+    if(length <= 0) {
+      break;
+    }
+    total += static_cast<size_t>(length);
+    if(static_cast<size_t>(length) < wanted) {
+      break;                                                                    // a short read means we've reached the end, avoid a second syscall
+    }
+  }
+  return total;
+}
+
+inline size_t read_file(int dirfd, char const *name, char *buffer, size_t size) {
+  /// Open, read and close a pseudo-file relative to a directory descriptor; returns 0 on failure
+  int const fd{openat(dirfd, name, O_RDONLY | O_CLOEXEC)};
+  if(fd < 0) {
+    return 0;
+  }
+  size_t const total{read_fd(fd, buffer, size)};
+  close(fd);
+  return total;
+}
+
+template<typename Callback>
+void for_each_key_value(char const *it, char const *end, Callback &&callback) {
+  /// Call back with each "key value" or "Key:   value unit" line's key and leading number
+  while(it != end) {
+    char const *const key_begin{it};
+    while(it != end && *it != ' ' && *it != '\t' && *it != ':' && *it != '\n') {
+      ++it;
+    }
+    std::string_view const key{key_begin, static_cast<size_t>(it - key_begin)};
+    if(it != end && *it == ':') {
+      ++it;
+    }
+    it = skip_spaces(it, end);
+    uint64_t value{0};
+    it = parse_uint(it, end, value);
+    callback(key, value);
+    while(it != end && *it != '\n') {
+      ++it;
+    }
+    if(it != end) {
+      ++it;
+    }
+  }
+}
+
+template<typename Callback>
+void for_each_line(int fd, char *buffer, size_t size, Callback &&callback) {
+  /// Stream a pseudo-file of any length through a fixed buffer, calling back with each line minus its newline; overlong lines are truncated to the buffer size
+  size_t held{0};
+  bool truncating{false};
+  while(true) {
+    ssize_t const length{read(fd, buffer + held, size - held)};
+    if(length <= 0) {
+      break;
+    }
+    char const *const end{buffer + held + length};
+    char const *line{buffer};
+    for(char const *newline; (newline = static_cast<char const*>(std::memchr(line, '\n', static_cast<size_t>(end - line)))); line = newline + 1) {
+      if(!truncating) {
+        callback(std::string_view{line, static_cast<size_t>(newline - line)});
+      }
+      truncating = false;
+    }
+    held = static_cast<size_t>(end - line);
+    if(held == size) {                                                          // no newline in a full buffer: report what we have and skip the rest of the line
+      if(!truncating) {
+        callback(std::string_view{buffer, size});
+      }
+      truncating = true;
+      held = 0;
+    } else {
+      std::memmove(buffer, line, held);
+    }
+  }
+  if(held != 0 && !truncating) {
+    callback(std::string_view{buffer, held});
+  }
+}
+
+}
+}
@@ -0,0 +1,258 @@
+#include "residency.h"
+#include <algorithm>
+#include <thread>
+#include "platform_defines.h"
+#if defined(PLATFORM_WINDOWS)
+  #include <windows.h>
+  #include <psapi.h>
+#elif !defined(PLATFORM_EMSCRIPTEN)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #if defined(PLATFORM_LINUX)
+    #include "smaps.h"
+    #define MEMORYSTORM_PAGEMAP_SUPPORTED
+  #endif // defined(PLATFORM_LINUX)
+  #define MEMORYSTORM_MINCORE_SUPPORTED
+#endif // platform selection
+
+namespace memorystorm {
+
+namespace {
+
+uint64_t constexpr chunk_pages{16384};                                          // pages queried per syscall, bounding the scratch buffers
+
+uint64_t get_page_size() {
+  /// The base page size, which residency is reported in
+  #if defined(PLATFORM_WINDOWS)
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+  #elif defined(MEMORYSTORM_MINCORE_SUPPORTED)
+    return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  #else
+    return 65536;                                                               // WebAssembly page size
+  #endif // platform selection
+}
+
+struct page_span {
+  uintptr_t start{0};
+  uint64_t pages{0};
+};
+
+page_span to_page_span(void const *address, size_t length, uint64_t page_size) {
+  /// Round a range out to whole pages
+  if(length == 0) {
+    return {};
+  }
+  uintptr_t const mask{~static_cast<uintptr_t>(page_size - 1)};
+  uintptr_t const start{reinterpret_cast<uintptr_t>(address) & mask};
+  uintptr_t const end{(reinterpret_cast<uintptr_t>(address) + length + page_size - 1) & mask};
+  return {start, (end - start) / page_size};
+}
+
+#if defined(MEMORYSTORM_MINCORE_SUPPORTED)
+int query_mincore(uintptr_t address, size_t length, unsigned char *vector) {
+  #if defined(PLATFORM_MACOS)
+    return mincore(reinterpret_cast<caddr_t>(address), length, reinterpret_cast<char*>(vector));
+  #else
+    return mincore(reinterpret_cast<void*>(address), length, vector);
+  #endif // defined(PLATFORM_MACOS)
+}
+#endif // defined(MEMORYSTORM_MINCORE_SUPPORTED)
+
+class residency_scanner {
+  /// Scratch buffers and descriptors shared by every range in a batch, so a batch costs one setup
+  uint32_t const fields;
+  uint64_t const page_size{get_page_size()};
+  #if defined(PLATFORM_WINDOWS)
+    std::vector<PSAPI_WORKING_SET_EX_INFORMATION> working_set;
+  #elif defined(MEMORYSTORM_MINCORE_SUPPORTED)
+    std::vector<unsigned char> vector;
+  #endif // platform selection
+  #if defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+    std::vector<uint64_t> entries;
+    int pagemap_fd{-1};
+    std::vector<smaps_mapping> mappings;
+  #endif // defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+
+  void scan_chunk(uintptr_t address, uint64_t first, uint64_t count, page_residency &result);
+
+public:
+  explicit residency_scanner(uint32_t this_fields)
+    : fields{this_fields} {
+    #if defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+      if(fields & residency_field::pagemap) {
+        pagemap_fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+      }
+      if(fields & residency_field::huge_pages) {
+        mappings = get_mappings();                                              // one smaps walk for the whole batch
+      }
+    #endif // defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+  }
+  residency_scanner(residency_scanner const&) = delete;
+  residency_scanner &operator=(residency_scanner const&) = delete;
+  ~residency_scanner() {
+    #if defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+      if(pagemap_fd >= 0) {
+        close(pagemap_fd);
+      }
+    #endif // defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+  }
+
+  page_residency scan(void const *address, size_t length);
+};
+
+void residency_scanner::scan_chunk(uintptr_t address, uint64_t first, uint64_t count, page_residency &result) {
+  /// Query count pages starting at address, which is page first of the range
+  auto const mark_resident{[&](uint64_t page){
+    ++result.resident_pages;
+    if(fields & residency_field::bitmap) {
+      result.bitmap[page / 8] |= static_cast<uint8_t>(1u << (page % 8));
+    }
+  }};
+  #if defined(PLATFORM_WINDOWS)
+    working_set.resize(count);
+    for(uint64_t i{0}; i != count; ++i) {
+      working_set[i].VirtualAddress = reinterpret_cast<PVOID>(address + i * page_size);
+    }
+    if(!QueryWorkingSetEx(GetCurrentProcess(), working_set.data(), static_cast<DWORD>(count * sizeof(PSAPI_WORKING_SET_EX_INFORMATION)))) {
+      return;
+    }
+    for(uint64_t i{0}; i != count; ++i) {
+      auto const &attributes{working_set[i].VirtualAttributes};
+      if(!attributes.Valid) {
+        continue;
+      }
+      mark_resident(first + i);
+      if(attributes.Shared) {
+        ++result.file_pages;
+      }
+      if(attributes.LargePage) {
+        result.huge_page_bytes += page_size;
+      }
+    }
+  #elif defined(MEMORYSTORM_MINCORE_SUPPORTED)
+    vector.resize(count);
+    if(query_mincore(address, count * page_size, vector.data()) != 0) {
+      return;                                                                   // part of the range isn't mapped; report it as not resident
+    }
+    for(uint64_t i{0}; i != count; ++i) {
+      if(vector[i] & 1u) {
+        mark_resident(first + i);
+      }
+    }
+    #if defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+      if(pagemap_fd >= 0) {
+        entries.resize(count);
+        ssize_t const length{pread(pagemap_fd, entries.data(), count * sizeof(uint64_t), static_cast<off_t>(address / page_size * sizeof(uint64_t)))};
+        uint64_t const read_count{length > 0 ? static_cast<uint64_t>(length) / sizeof(uint64_t) : 0};
+        for(uint64_t i{0}; i != read_count; ++i) {
+          uint64_t const entry{entries[i]};
+          if(entry & (uint64_t{1} << 62)) {                                     // swapped
+            ++result.swapped_pages;
+          } else if((entry & (uint64_t{1} << 63)) && (entry & (uint64_t{1} << 61))) { // present, and file-backed or shared anonymous
+            ++result.file_pages;
+          }
+        }
+      }
+    #endif // defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+  #else
+    (void)address;
+    (void)first;
+    (void)count;
+    (void)mark_resident;
+  #endif // platform selection
+}
+
+page_residency residency_scanner::scan(void const *address, size_t length) {
+  /// Residency of one range, in bounded chunks so multi-gigabyte mappings don't need a huge buffer
+  page_residency result;
+  result.page_size = page_size;
+  page_span const span{to_page_span(address, length, page_size)};
+  result.pages = span.pages;
+  if(fields & residency_field::bitmap) {
+    result.bitmap.assign((span.pages + 7) / 8, 0);
+  }
+  for(uint64_t first{0}; first < span.pages; first += chunk_pages) {
+    uint64_t const count{std::min(chunk_pages, span.pages - first)};
+    scan_chunk(span.start + first * page_size, first, count, result);
+  }
+  #if defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+    uintptr_t const end{span.start + span.pages * page_size};
+    auto it{std::upper_bound(mappings.begin(), mappings.end(), span.start, [](uintptr_t value, smaps_mapping const &mapping){
+      return value < mapping.end;
+    })};
+    for(; it != mappings.end() && it->start < end; ++it) {
+      result.huge_page_bytes += it->memory.anon_huge_pages + it->memory.shmem_pmd_mapped + it->memory.file_pmd_mapped;
+    }
+  #endif // defined(MEMORYSTORM_PAGEMAP_SUPPORTED)
+  return result;
+}
+
+void advise_will_need(void const *address, size_t length) {
+  /// Ask the kernel to start reading a range in asynchronously
+  uint64_t const page_size{get_page_size()};
+  page_span const span{to_page_span(address, length, page_size)};
+  if(span.pages == 0) {
+    return;
+  }
+  #if defined(PLATFORM_WINDOWS)
+    #if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+      WIN32_MEMORY_RANGE_ENTRY entry{reinterpret_cast<PVOID>(span.start), static_cast<SIZE_T>(span.pages * page_size)};
+      PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+    #endif // Windows 8 or later
+  #elif defined(MEMORYSTORM_MINCORE_SUPPORTED)
+    madvise(reinterpret_cast<void*>(span.start), span.pages * page_size, MADV_WILLNEED);
+  #endif // platform selection
+}
+
+}
+
+page_residency get_residency(void const *address, size_t length, uint32_t fields) {
+  /// Residency of one address range; resident_pages is always filled, other fields on request
+  residency_scanner scanner{fields};
+  return scanner.scan(address, length);
+}
+
+std::vector<page_residency> get_residency(std::vector<address_range> const &ranges, uint32_t fields) {
+  /// Residency of many address ranges, sharing buffers, descriptors and the smaps walk across them
+  residency_scanner scanner{fields};
+  std::vector<page_residency> result;
+  result.reserve(ranges.size());
+  for(auto const &range : ranges) {
+    result.emplace_back(scanner.scan(range.address, range.length));
+  }
+  return result;
+}
+
+double prefetch(void const *address, size_t length, double target_fraction, std::chrono::milliseconds timeout) {
+  /// Start reading a range in and wait until at least target_fraction of it is resident or the timeout expires; returns the fraction reached
+  auto const deadline{std::chrono::steady_clock::now() + timeout};
+  residency_scanner scanner{0};
+  while(true) {
+    double const fraction{scanner.scan(address, length).resident_fraction()};
+    if(fraction >= target_fraction || std::chrono::steady_clock::now() >= deadline) {
+      return fraction;
+    }
+    advise_will_need(address, length);                                          // repeated in case pages were reclaimed meanwhile; cheap for pages already resident
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+}
+
+bool prefetch_file(int fd, uint64_t offset, uint64_t length) {
+  /// Start reading part of a file into the page cache without mapping it
+  #if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+    return readahead(fd, static_cast<off64_t>(offset), static_cast<size_t>(length)) == 0;
+  #elif defined(PLATFORM_MACOS)
+    radvisory advisory{static_cast<off_t>(offset), static_cast<int>(std::min<uint64_t>(length, INT32_MAX))};
+    return fcntl(fd, F_RDADVISE, &advisory) != -1;
+  #else
+    (void)fd;
+    (void)offset;
+    (void)length;
+    return false;
+  #endif // platform selection
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+/// Page residency of address ranges such as mapped files, and prefetching them into memory
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+namespace residency_field {
+uint32_t constexpr bitmap{    1u << 0};                                         // per-page resident bits
+uint32_t constexpr pagemap{   1u << 1};                                         // swapped and file-backed counts from /proc/self/pagemap (Linux)
+uint32_t constexpr huge_pages{1u << 2};                                         // huge page backing from /proc/self/smaps (Linux) or the working set (Windows)
+uint32_t constexpr all{bitmap | pagemap | huge_pages};
+}
+
+struct address_range {
+  void const *address{nullptr};
+  size_t length{0};
+};
+
+struct page_residency {
+  /// Which pages of a range are in physical memory; counts beyond resident_pages are only filled when requested
+  uint64_t page_size{0};
+  uint64_t pages{0};                                                            // pages spanned by the range, after rounding out to page boundaries
+  uint64_t resident_pages{0};
+  uint64_t swapped_pages{0};
+  uint64_t file_pages{0};                                                       // resident pages backed by a file or shared memory
+  uint64_t huge_page_bytes{0};                                                  // on Linux, for the whole of each mapping the range overlaps
+  std::vector<uint8_t> bitmap;                                                  // bit (i % 8) of byte (i / 8) is set if page i is resident
+
+  bool is_resident(uint64_t page) const {
+    return page < bitmap.size() * 8 && (bitmap[page / 8] >> (page % 8)) & 1u;
+  }
+  double resident_fraction() const {
+    return pages == 0 ? 0.0 : static_cast<double>(resident_pages) / static_cast<double>(pages);
+  }
+};
+
+page_residency get_residency(void const *address, size_t length, uint32_t fields = 0);
+std::vector<page_residency> get_residency(std::vector<address_range> const &ranges, uint32_t fields = 0);
+
+double prefetch(void const *address,
+                size_t length,
+                double target_fraction = 1.0,
+                std::chrono::milliseconds timeout = std::chrono::milliseconds{1000});
+bool prefetch_file(int fd, uint64_t offset, uint64_t length);
+
+}
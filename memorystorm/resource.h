@@ -0,0 +1,92 @@
+#pragma once
+
+/// Common base for memorystorm's memory resources, which enforce a byte budget and report their usage to get_stats()
+
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+struct allocator_stats {
+  /// Usage of one arena or pool
+  std::string name;
+  uint64_t reserved_bytes{0};                                                   // obtained from the upstream resource
+  uint64_t used_bytes{0};                                                       // currently handed out to callers
+  uint64_t peak_used_bytes{0};
+  uint64_t budget{unlimited};                                                   // limit on reserved bytes
+  uint64_t failed_allocations{0};                                               // refused because they would have exceeded the budget
+};
+
+class tracked_resource : public std::pmr::memory_resource {
+  /// Counters are written only by the owning thread and read from anywhere
+  std::string const name;
+  uint64_t const budget;
+  std::atomic<uint64_t> reserved{0};
+  std::atomic<uint64_t> used{0};
+  std::atomic<uint64_t> peak{0};
+  std::atomic<uint64_t> failures{0};
+
+  static void owner_add(std::atomic<uint64_t> &counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+  static void owner_sub(std::atomic<uint64_t> &counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) - amount, std::memory_order_relaxed);
+  }
+
+protected:
+  tracked_resource(std::string name, uint64_t budget);
+  ~tracked_resource() override;
+
+  bool try_reserve(uint64_t bytes) {
+    /// Account for memory about to be taken from upstream; false, and counted as a failure, if over budget
+    uint64_t const current{reserved.load(std::memory_order_relaxed)};
+    if(bytes > budget || current > budget - bytes) {
+      owner_add(failures, 1);
+      return false;
+    }
+    reserved.store(current + bytes, std::memory_order_relaxed);
+    return true;
+  }
+  void unreserve(uint64_t bytes) {
+    owner_sub(reserved, bytes);
+  }
+  void add_used(uint64_t bytes) {
+    uint64_t const current{used.load(std::memory_order_relaxed) + bytes};
+    used.store(current, std::memory_order_relaxed);
+    if(current > peak.load(std::memory_order_relaxed)) {
+      peak.store(current, std::memory_order_relaxed);
+    }
+  }
+  void sub_used(uint64_t bytes) {
+    owner_sub(used, bytes);
+  }
+  void clear_used() {
+    used.store(0, std::memory_order_relaxed);
+  }
+
+public:
+  tracked_resource(tracked_resource const&) = delete;
+  tracked_resource &operator=(tracked_resource const&) = delete;
+
+  std::string const &get_name() const {
+    return name;
+  }
+  uint64_t get_budget() const {
+    return budget;
+  }
+  uint64_t get_reserved_bytes() const {
+    return reserved.load(std::memory_order_relaxed);
+  }
+  uint64_t get_used_bytes() const {
+    return used.load(std::memory_order_relaxed);
+  }
+  allocator_stats get_usage() const;
+};
+
+std::vector<allocator_stats> get_allocator_stats();
+
+}
@@ -0,0 +1,178 @@
+#include "sampler.h"
+
+namespace memorystorm {
+
+namespace {
+
+void to_values(snapshot const &memory, uint64_t (&values)[sampler::value_count]) {
+  /// Flatten a snapshot for storage in a slot
+  values[0] = memory.stack_available;
+  values[1] = memory.physical_total;
+  values[2] = memory.physical_available;
+  values[3] = memory.physical_usage;
+  values[4] = memory.virtual_total;
+  values[5] = memory.virtual_available;
+  values[6] = memory.virtual_usage;
+}
+
+snapshot from_values(uint64_t const (&values)[sampler::value_count]) {
+  /// Rebuild a snapshot from slot storage
+  snapshot memory{};
+  memory.stack_available    = values[0];
+  memory.physical_total     = values[1];
+  memory.physical_available = values[2];
+  memory.physical_usage     = values[3];
+  memory.virtual_total      = values[4];
+  memory.virtual_available  = values[5];
+  memory.virtual_usage      = values[6];
+  return memory;
+}
+
+}
+
+sampler::sampler(std::chrono::nanoseconds interval, uint32_t this_fields)
+  : fields{this_fields},
+    interval_ns{interval.count()} {
+}
+
+sampler::~sampler() {
+  stop();
+}
+
+void sampler::publish(sample const &value) {
+  /// Write a sample into the next slot under its seqlock; only ever called from the sampling thread
+  uint64_t const generation{published.load(std::memory_order_relaxed) + 1};
+  slot &target{slots[(generation - 1) % capacity]};
+  uint64_t const sequence{target.sequence.load(std::memory_order_relaxed)};
+  target.sequence.store(sequence + 1, std::memory_order_relaxed);               // odd: write in progress
+  std::atomic_thread_fence(std::memory_order_release);
+  uint64_t values[value_count];
+  to_values(value.memory, values);
+  target.generation.store(generation, std::memory_order_relaxed);
+  target.time.store(value.time.time_since_epoch().count(), std::memory_order_relaxed);
+  for(size_t i{0}; i != value_count; ++i) {
+    target.values[i].store(values[i], std::memory_order_relaxed);
+  }
+  target.sequence.store(sequence + 2, std::memory_order_release);               // even: write complete
+  published.store(generation, std::memory_order_release);
+}
+
+bool sampler::read_slot(uint64_t generation, sample &out) const {
+  /// Read the given sample number, returning false if it has already been overwritten
+  slot const &source{slots[(generation - 1) % capacity]};
+  while(true) {
+    uint64_t const sequence_before{source.sequence.load(std::memory_order_acquire)};
+    if(sequence_before & 1u) {
+      continue;                                                                 // writer is mid-update, retry
+    }
+    uint64_t const slot_generation{source.generation.load(std::memory_order_relaxed)};
+    int64_t const time{source.time.load(std::memory_order_relaxed)};
+    uint64_t values[value_count];
+    for(size_t i{0}; i != value_count; ++i) {
+      values[i] = source.values[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(source.sequence.load(std::memory_order_relaxed) != sequence_before) {
+      continue;                                                                 // torn read, retry
+    }
+    if(slot_generation != generation) {
+      return false;
+    }
+    out.time = std::chrono::steady_clock::time_point{std::chrono::steady_clock::duration{time}};
+    out.memory = from_values(values);
+    return true;
+  }
+}
+
+void sampler::run() {
+  /// Sampling loop, sleeping on a condition variable so stop and interval changes take effect immediately
+  std::unique_lock<std::mutex> lock{worker_mutex};
+  while(!stop_requested) {
+    interval_changed = false;
+    auto const deadline{std::chrono::steady_clock::now() + std::chrono::nanoseconds{interval_ns.load(std::memory_order_relaxed)}};
+    if(worker_wake.wait_until(lock, deadline, [this]{return stop_requested || interval_changed;})) {
+      continue;                                                                 // woken early: either stopping or rescheduling with the new interval
+    }
+    lock.unlock();
+    publish(sample{std::chrono::steady_clock::now(), take_snapshot(fields)});
+    lock.lock();
+  }
+}
+
+void sampler::start() {
+  /// Take an initial sample synchronously, so readers have data immediately, then start the sampling thread
+  if(worker.joinable()) {
+    return;
+  }
+  publish(sample{std::chrono::steady_clock::now(), take_snapshot(fields)});
+  {
+    std::lock_guard<std::mutex> lock{worker_mutex};
+    stop_requested = false;
+  }
+  worker = std::thread{&sampler::run, this};
+}
+
+void sampler::stop() {
+  /// Stop and join the sampling thread; published samples remain readable
+  if(!worker.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock{worker_mutex};
+    stop_requested = true;
+  }
+  worker_wake.notify_all();
+  worker.join();
+}
+
+bool sampler::running() const {
+  /// Whether the sampling thread is currently active
+  return worker.joinable();
+}
+
+void sampler::set_interval(std::chrono::nanoseconds interval) {
+  /// Change the sampling interval; a sleeping sampler is rescheduled straight away
+  interval_ns.store(interval.count(), std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock{worker_mutex};
+    interval_changed = true;
+  }
+  worker_wake.notify_all();
+}
+
+std::chrono::nanoseconds sampler::get_interval() const {
+  /// Current sampling interval
+  return std::chrono::nanoseconds{interval_ns.load(std::memory_order_relaxed)};
+}
+
+uint64_t sampler::sample_count() const {
+  /// Total number of samples published since construction
+  return published.load(std::memory_order_acquire);
+}
+
+sample sampler::latest() const {
+  /// Most recent sample, or a zeroed sample if none has been taken yet
+  sample result{};
+  while(true) {
+    uint64_t const generation{published.load(std::memory_order_acquire)};
+    if(generation == 0 || read_slot(generation, result)) {
+      return result;
+    }
+  }
+}
+
+size_t sampler::history(sample *out, size_t count) const {
+  /// Copy up to count of the most recent samples into out, newest first, returning how many were copied
+  uint64_t generation{published.load(std::memory_order_acquire)};
+  size_t copied{0};
+  while(copied != count && copied != capacity && generation != 0) {
+    if(!read_slot(generation, out[copied])) {
+      break;                                                                    // the writer has lapped us, older samples are gone
+    }
+    ++copied;
+    --generation;
+  }
+  return copied;
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/// Background thread that periodically samples memory and publishes the results lock-free
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+struct sample {
+  /// A snapshot tagged with the time it was taken
+  std::chrono::steady_clock::time_point time{};
+  snapshot memory{};
+};
+
+class sampler {
+  /// Single-writer ring buffer of samples; readers never block and never make syscalls
+public:
+  static size_t constexpr capacity{64};
+  static size_t constexpr value_count{7};                                       // snapshot fields stored per slot
+
+private:
+  struct slot {
+    std::atomic<uint64_t> sequence{0};                                          // seqlock counter, odd while being written
+    std::atomic<uint64_t> generation{0};                                        // which sample number this slot holds, 1-based
+    std::atomic<int64_t> time{0};
+    std::array<std::atomic<uint64_t>, value_count> values{};
+  };
+
+  std::array<slot, capacity> slots{};
+  alignas(64) std::atomic<uint64_t> published{0};                               // total number of samples published so far
+
+  uint32_t const fields;
+  std::atomic<int64_t> interval_ns;
+
+  std::thread worker;
+  std::mutex worker_mutex;
+  std::condition_variable worker_wake;
+  bool stop_requested{false};
+  bool interval_changed{false};
+
+  void publish(sample const &value);
+  bool read_slot(uint64_t generation, sample &out) const;
+  void run();
+
+public:
+  explicit sampler(std::chrono::nanoseconds interval = std::chrono::milliseconds{100},
+                   uint32_t fields = field::system | field::process);           // stack_available would only measure the sampling thread's own stack
+  sampler(sampler const&) = delete;
+  sampler &operator=(sampler const&) = delete;
+  ~sampler();
+
+  void start();
+  void stop();
+  bool running() const;
+
+  void set_interval(std::chrono::nanoseconds interval);
+  std::chrono::nanoseconds get_interval() const;
+
+  uint64_t sample_count() const;
+  sample latest() const;
+  size_t history(sample *out, size_t count) const;
+};
+
+}
@@ -0,0 +1,137 @@
+#include "scope_tag.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include "alloc_counters.h"
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+namespace {
+
+struct tag_totals {
+  uint64_t allocated_bytes{0};
+  uint64_t freed_bytes{0};
+  uint64_t allocations{0};
+  uint64_t deallocations{0};
+  uint64_t peak_bytes{0};
+
+  uint64_t live_bytes() const {
+    return allocated_bytes > freed_bytes ? allocated_bytes - freed_bytes : 0;
+  }
+};
+
+struct tag_registry {
+  /// Tag names plus the read-side state used for rates; never touched on the allocation path
+  std::mutex mutex;
+  std::array<std::string, detail::max_alloc_tags> names{};
+  uint32_t count{1};
+  std::array<tag_totals, detail::max_alloc_tags> previous{};
+  std::chrono::steady_clock::time_point previous_time{};
+
+  tag_registry() {
+    names[untagged] = "untagged";
+  }
+};
+
+tag_registry &get_registry() {
+  static tag_registry registry;
+  return registry;
+}
+
+std::array<tag_totals, detail::max_alloc_tags> sum_tags() {
+  /// Merge every thread's per-tag counters; all zero unless built with MEMORYSTORM_ALLOC_TAGS
+  std::array<tag_totals, detail::max_alloc_tags> result{};
+  #if defined(MEMORYSTORM_ALLOC_TAGS)
+  auto const add{[&result](detail::alloc_shard const &shard){
+    for(uint32_t tag{0}; tag != detail::max_alloc_tags; ++tag) {
+      auto const &counters{shard.tags[tag]};
+      result[tag].allocated_bytes += counters.allocated_bytes.load(std::memory_order_relaxed);
+      result[tag].freed_bytes     += counters.freed_bytes.load(std::memory_order_relaxed);
+      result[tag].allocations     += counters.allocations.load(std::memory_order_relaxed);
+      result[tag].deallocations   += counters.deallocations.load(std::memory_order_relaxed);
+      result[tag].peak_bytes      += counters.max_live_bytes.load(std::memory_order_relaxed);
+    }
+  }};
+  for(detail::alloc_shard const *shard{detail::alloc_shards.load(std::memory_order_acquire)}; shard; shard = shard->next) {
+    add(*shard);
+  }
+  add(detail::orphan_alloc_shard);
+  for(auto &totals : result) {
+    totals.peak_bytes = std::max(std::min(totals.peak_bytes, totals.allocated_bytes), totals.live_bytes()); // the sum of each thread's own peak bounds the tag's peak from above
+  }
+  #endif // defined(MEMORYSTORM_ALLOC_TAGS)
+  return result;
+}
+
+}
+
+uint32_t register_tag(std::string const &name) {
+  /// Look up or create a tag by name; returns untagged once all tags are in use
+  auto &registry{get_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  for(uint32_t tag{0}; tag != registry.count; ++tag) {
+    if(registry.names[tag] == name) {
+      return tag;
+    }
+  }
+  if(registry.count == detail::max_alloc_tags) {
+    return untagged;
+  }
+  registry.names[registry.count] = name;
+  return registry.count++;
+}
+
+std::string get_tag_name(uint32_t tag) {
+  /// Name a tag was registered with, or empty if unknown
+  auto &registry{get_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  return tag < registry.count ? registry.names[tag] : std::string{};
+}
+
+std::vector<tag_stats> get_tag_stats() {
+  /// Accounting for every registered tag
+  auto const totals{sum_tags()};
+  auto const now{std::chrono::steady_clock::now()};
+  auto &registry{get_registry()};
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  double const elapsed{registry.previous_time == std::chrono::steady_clock::time_point{} ?
+                       0.0 : std::chrono::duration<double>(now - registry.previous_time).count()};
+  std::vector<tag_stats> result;
+  result.reserve(registry.count);
+  for(uint32_t tag{0}; tag != registry.count; ++tag) {
+    auto const &current{totals[tag]};
+    auto const &previous{registry.previous[tag]};
+    tag_stats stats;
+    stats.tag              = tag;
+    stats.name             = registry.names[tag];
+    stats.live_bytes       = current.live_bytes();
+    stats.peak_bytes       = current.peak_bytes;
+    stats.allocated_bytes  = current.allocated_bytes;
+    stats.allocations      = current.allocations;
+    stats.live_allocations = current.allocations > current.deallocations ? current.allocations - current.deallocations : 0;
+    if(elapsed > 0.0) {
+      stats.allocations_per_second = static_cast<double>(current.allocations     - previous.allocations)     / elapsed;
+      stats.bytes_per_second       = static_cast<double>(current.allocated_bytes - previous.allocated_bytes) / elapsed;
+    }
+    result.emplace_back(std::move(stats));
+  }
+  registry.previous = totals;
+  registry.previous_time = now;
+  return result;
+}
+
+std::string get_tag_report() {
+  /// Human readable per-tag summary, one line per tag
+  std::stringstream ss;
+  for(auto const &stats : get_tag_stats()) {
+    ss << "MemoryStorm: Tag " << stats.name << " live " << human_readable(stats.live_bytes) <<
+          " (peak " << human_readable(stats.peak_bytes) << ") in " << stats.live_allocations << " allocations, " <<
+          static_cast<uint64_t>(stats.allocations_per_second) << " allocations/s" << std::endl;
+  }
+  return ss.str();
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+/// Scoped memory attribution tags, for per-subsystem allocation accounting through the allocation hooks
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace memorystorm {
+
+namespace detail {
+inline thread_local uint32_t current_alloc_tag{0};                              // constant-initialised, so reading it is a plain TLS load
+}
+
+uint32_t constexpr untagged{0};
+
+uint32_t register_tag(std::string const &name);
+std::string get_tag_name(uint32_t tag);
+
+inline uint32_t get_current_tag() {
+  /// The tag that allocations on this thread are currently charged to
+  return detail::current_alloc_tag;
+}
+
+class scope_tag {
+  /// Charges allocations made on this thread to a tag for the lifetime of the object; nests
+  uint32_t const previous;
+
+public:
+  explicit scope_tag(uint32_t tag)
+    : previous{detail::current_alloc_tag} {
+    detail::current_alloc_tag = tag;
+  }
+  scope_tag(scope_tag const&) = delete;
+  scope_tag &operator=(scope_tag const&) = delete;
+  ~scope_tag() {
+    detail::current_alloc_tag = previous;
+  }
+};
+
+struct tag_stats {
+  /// Accounting for one tag; rates cover the time since the previous call to get_tag_stats()
+  uint32_t tag{untagged};
+  std::string name;
+  uint64_t live_bytes{0};
+  uint64_t peak_bytes{0};                                                       // sum of each thread's own peak; exact unless blocks are freed on other threads, then an overestimate
+  uint64_t allocated_bytes{0};
+  uint64_t allocations{0};
+  uint64_t live_allocations{0};
+  double allocations_per_second{0.0};
+  double bytes_per_second{0.0};
+};
+
+std::vector<tag_stats> get_tag_stats();
+std::string get_tag_report();
+
+}
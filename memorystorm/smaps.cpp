@@ -0,0 +1,233 @@
+#include "smaps.h"
+#include <algorithm>
+#include "platform_defines.h"
+#if defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+  #include <string_view>
+  #include "procfs.h"
+  #define MEMORYSTORM_SMAPS_SUPPORTED
+#endif // defined(PLATFORM_LINUX) && !defined(PLATFORM_EMSCRIPTEN)
+
+namespace memorystorm {
+
+namespace {
+
+#if defined(MEMORYSTORM_SMAPS_SUPPORTED)
+struct smaps_key {
+  std::string_view key;
+  uint64_t smaps_stats::*member;
+};
+
+smaps_key constexpr smaps_keys[]{                                               // in the order the kernel prints them; all in kB
+  {"Rss",             &smaps_stats::rss},
+  {"Pss",             &smaps_stats::pss},
+  {"Pss_Anon",        &smaps_stats::pss_anon},
+  {"Pss_File",        &smaps_stats::pss_file},
+  {"Pss_Shmem",       &smaps_stats::pss_shmem},
+  {"Shared_Clean",    &smaps_stats::shared_clean},
+  {"Shared_Dirty",    &smaps_stats::shared_dirty},
+  {"Private_Clean",   &smaps_stats::private_clean},
+  {"Private_Dirty",   &smaps_stats::private_dirty},
+  {"Referenced",      &smaps_stats::referenced},
+  {"Anonymous",       &smaps_stats::anonymous},
+  {"AnonHugePages",   &smaps_stats::anon_huge_pages},
+  {"ShmemPmdMapped",  &smaps_stats::shmem_pmd_mapped},
+  {"FilePmdMapped",   &smaps_stats::file_pmd_mapped},
+  {"Swap",            &smaps_stats::swap},
+  {"SwapPss",         &smaps_stats::swap_pss},
+  {"Locked",          &smaps_stats::locked},
+};
+
+size_t constexpr max_path_length{256};
+
+struct mapping_header {
+  /// A mapping's header line, held in fixed storage so parsing allocates nothing
+  uintptr_t start{0};
+  uintptr_t end{0};
+  char permissions[5]{};
+  uint64_t offset{0};
+  char path[max_path_length]{};
+  size_t path_length{0};
+};
+
+char const *parse_hex(char const *it, char const *end, uint64_t &value) {
+  /// Parse an unsigned hexadecimal integer, stopping at the first non-digit
+  uint64_t result{0};
+  for(; it != end; ++it) {
+    char const c{*it};
+    unsigned int digit;
+    if(c >= '0' && c <= '9') {
+      digit = static_cast<unsigned int>(c - '0');
+    } else if(c >= 'a' && c <= 'f') {
+      digit = static_cast<unsigned int>(c - 'a' + 10);
+    } else {
+      break;
+    }
+    result = (result << 4) | digit;
+  }
+  value = result;
+  return it;
+}
+
+bool parse_header(std::string_view line, mapping_header &header) {
+  /// Parse "start-end perms offset dev inode [path]"; false if this isn't a header line
+  char const *it{line.data()};
+  char const *const end{it + line.size()};
+  uint64_t start{0};
+  char const *const after_start{parse_hex(it, end, start)};
+  if(after_start == it || after_start == end || *after_start != '-') {
+    return false;
+  }
+  uint64_t finish{0};
+  it = parse_hex(after_start + 1, end, finish);
+  header.start = static_cast<uintptr_t>(start);
+  header.end = static_cast<uintptr_t>(finish);
+  it = procfs::skip_spaces(it, end);
+  for(size_t i{0}; i != 4; ++i) {
+    header.permissions[i] = it != end ? *it++ : '\0';
+  }
+  header.permissions[4] = '\0';
+  it = procfs::skip_spaces(it, end);
+  it = parse_hex(it, end, header.offset);
+  for(unsigned int skip{0}; skip != 2; ++skip) {                                // device and inode
+    it = procfs::skip_spaces(it, end);
+    while(it != end && *it != ' ' && *it != '\t') {
+      ++it;
+    }
+  }
+  it = procfs::skip_spaces(it, end);
+  header.path_length = std::min(static_cast<size_t>(end - it), max_path_length);
+  std::copy(it, it + header.path_length, header.path);
+  return true;
+}
+
+void parse_field(std::string_view line, smaps_stats &stats) {
+  /// Parse a "Key:   value kB" line into the matching field
+  auto const colon{line.find(':')};
+  if(colon == std::string_view::npos) {
+    return;
+  }
+  std::string_view const key{line.substr(0, colon)};
+  for(auto const &entry : smaps_keys) {
+    if(entry.key == key) {
+      char const *const end{line.data() + line.size()};
+      uint64_t value{0};
+      procfs::parse_uint(procfs::skip_spaces(line.data() + colon + 1, end), end, value);
+      stats.*entry.member = value * 1024;
+      return;
+    }
+  }
+}
+
+smaps_mapping to_mapping(mapping_header const &header, smaps_stats const &stats) {
+  /// Copy a parsed mapping out of fixed storage
+  smaps_mapping mapping;
+  mapping.start = header.start;
+  mapping.end = header.end;
+  std::copy(std::begin(header.permissions), std::end(header.permissions), mapping.permissions);
+  mapping.offset = header.offset;
+  mapping.path.assign(header.path, header.path_length);
+  mapping.memory = stats;
+  return mapping;
+}
+
+void add(smaps_stats &total, smaps_stats const &part) {
+  for(auto const &entry : smaps_keys) {
+    total.*entry.member += part.*entry.member;
+  }
+}
+
+template<typename Callback>
+bool for_each_mapping(Callback &&callback) {
+  /// Stream /proc/self/smaps, calling back with each mapping's header and memory; smaps can be megabytes, so nothing is allocated per line
+  int const fd{open("/proc/self/smaps", O_RDONLY | O_CLOEXEC)};
+  if(fd < 0) {
+    return false;
+  }
+  char buffer[16384];
+  mapping_header header;
+  smaps_stats stats{};
+  bool have_mapping{false};
+  procfs::for_each_line(fd, buffer, sizeof(buffer), [&](std::string_view line){
+    mapping_header next;
+    if(parse_header(line, next)) {
+      if(have_mapping) {
+        callback(header, stats);
+      }
+      header = next;
+      stats = smaps_stats{};
+      have_mapping = true;
+    } else if(have_mapping) {
+      parse_field(line, stats);
+    }
+  });
+  if(have_mapping) {
+    callback(header, stats);
+  }
+  close(fd);
+  return true;
+}
+#endif // defined(MEMORYSTORM_SMAPS_SUPPORTED)
+
+}
+
+smaps_stats get_smaps_rollup() {
+  /// Memory totals across all of this process's mappings; sums /proc/self/smaps on kernels before 4.14
+  smaps_stats result{};
+  #if defined(MEMORYSTORM_SMAPS_SUPPORTED)
+    int const fd{open("/proc/self/smaps_rollup", O_RDONLY | O_CLOEXEC)};
+    if(fd < 0) {
+      for_each_mapping([&](mapping_header const&, smaps_stats const &stats){
+        add(result, stats);
+      });
+      return result;
+    }
+    char buffer[2048];
+    procfs::for_each_line(fd, buffer, sizeof(buffer), [&](std::string_view line){
+      parse_field(line, result);
+    });
+    close(fd);
+  #endif // defined(MEMORYSTORM_SMAPS_SUPPORTED)
+  return result;
+}
+
+std::vector<smaps_mapping> get_mappings() {
+  /// Every mapping in address order
+  std::vector<smaps_mapping> result;
+  #if defined(MEMORYSTORM_SMAPS_SUPPORTED)
+    for_each_mapping([&](mapping_header const &header, smaps_stats const &stats){
+      result.emplace_back(to_mapping(header, stats));
+    });
+  #endif // defined(MEMORYSTORM_SMAPS_SUPPORTED)
+  return result;
+}
+
+std::vector<smaps_mapping> get_top_mappings(size_t count) {
+  /// The count mappings with the most resident memory, largest first
+  std::vector<smaps_mapping> result;
+  #if defined(MEMORYSTORM_SMAPS_SUPPORTED)
+    if(count == 0) {
+      return result;
+    }
+    result.reserve(count);
+    auto const smaller_rss{[](smaps_mapping const &lhs, smaps_mapping const &rhs){
+      return lhs.memory.rss > rhs.memory.rss;                                   // min-heap on rss, so the front is the first to drop
+    }};
+    for_each_mapping([&](mapping_header const &header, smaps_stats const &stats){
+      if(result.size() == count) {
+        if(stats.rss <= result.front().memory.rss) {
+          return;                                                               // the common case: doesn't make the cut, so don't build a string for it
+        }
+        std::pop_heap(result.begin(), result.end(), smaller_rss);
+        result.pop_back();
+      }
+      result.emplace_back(to_mapping(header, stats));
+      std::push_heap(result.begin(), result.end(), smaller_rss);
+    });
+    std::sort_heap(result.begin(), result.end(), smaller_rss);
+  #else
+    (void)count;
+  #endif // defined(MEMORYSTORM_SMAPS_SUPPORTED)
+  return result;
+}
+
+}
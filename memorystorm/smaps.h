@@ -0,0 +1,52 @@
+#pragma once
+
+/// Breakdown of this process's memory by kind, from /proc/self/smaps_rollup and /proc/self/smaps
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+struct smaps_stats {
+  /// Resident, proportional and swapped memory in bytes; fields the kernel doesn't report are left at zero
+  uint64_t rss{0};
+  uint64_t pss{0};                                                              // shared pages divided between the processes sharing them
+  uint64_t pss_anon{0};
+  uint64_t pss_file{0};
+  uint64_t pss_shmem{0};
+  uint64_t shared_clean{0};
+  uint64_t shared_dirty{0};
+  uint64_t private_clean{0};
+  uint64_t private_dirty{0};
+  uint64_t referenced{0};
+  uint64_t anonymous{0};
+  uint64_t anon_huge_pages{0};
+  uint64_t shmem_pmd_mapped{0};
+  uint64_t file_pmd_mapped{0};
+  uint64_t swap{0};
+  uint64_t swap_pss{0};
+  uint64_t locked{0};
+};
+
+struct smaps_mapping {
+  /// One mapping's address range and identity, with its memory
+  uintptr_t start{0};
+  uintptr_t end{0};
+  char permissions[5]{};                                                        // e.g. "rw-p"
+  uint64_t offset{0};
+  std::string path;                                                             // file path, or a pseudo-name such as "[heap]"; empty for anonymous mappings
+  smaps_stats memory{};
+
+  uint64_t size() const {
+    return end - start;
+  }
+};
+
+smaps_stats get_smaps_rollup();
+std::vector<smaps_mapping> get_mappings();
+std::vector<smaps_mapping> get_top_mappings(size_t count = 10);
+
+}
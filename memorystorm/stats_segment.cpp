@@ -0,0 +1,290 @@
+#include "stats_segment.h"
+#include <atomic>
+#include <new>
+#include "export.h"
+#include "platform_defines.h"
+#if defined(PLATFORM_WINDOWS)
+  #include <windows.h>
+  #define MEMORYSTORM_STATS_SEGMENT_SUPPORTED
+#elif !defined(PLATFORM_EMSCRIPTEN)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define MEMORYSTORM_STATS_SEGMENT_SUPPORTED
+#endif // platform selection
+
+namespace memorystorm {
+
+namespace detail {
+
+size_t constexpr stats_segment_values{std::size(snapshot_members)};
+
+struct stats_segment {
+  /// Layout shared between processes; only lock-free atomics, which are address-free, so it works across mappings
+  std::atomic<uint32_t> magic;                                                  // stored last when creating, so readers never see a half-built header
+  uint32_t version;
+  uint32_t size;
+  uint32_t pid;
+  std::atomic<uint64_t> sequence;                                               // seqlock counter, odd while being written
+  std::atomic<uint64_t> updates;
+  std::atomic<int64_t> time;
+  std::atomic<uint64_t> values[stats_segment_values];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared segment needs lock-free 64-bit atomics");
+
+}
+
+namespace {
+
+uint32_t constexpr segment_magic{0x4d53544d};                                   // "MSTM"
+uint32_t constexpr segment_version{1};
+unsigned int constexpr max_read_attempts{1'000};                                // give up rather than spin forever if the publisher died mid-write
+
+uint32_t get_current_pid() {
+  #if defined(PLATFORM_WINDOWS)
+    return static_cast<uint32_t>(GetCurrentProcessId());
+  #elif defined(MEMORYSTORM_STATS_SEGMENT_SUPPORTED)
+    return static_cast<uint32_t>(getpid());
+  #else
+    return 0;
+  #endif // platform selection
+}
+
+}
+
+std::string get_stats_segment_name(uint32_t pid) {
+  /// Name of the segment a process publishes to
+  #if defined(PLATFORM_WINDOWS)
+    return "Local\\memorystorm." + std::to_string(pid);
+  #else
+    return "/memorystorm." + std::to_string(pid);
+  #endif // defined(PLATFORM_WINDOWS)
+}
+
+stats_publisher::stats_publisher(std::chrono::nanoseconds this_interval, uint32_t this_fields)
+  : fields{this_fields},
+    interval{this_interval} {
+}
+
+stats_publisher::~stats_publisher() {
+  stop();
+  #if defined(PLATFORM_WINDOWS)
+    if(segment) {
+      UnmapViewOfFile(segment);
+      CloseHandle(static_cast<HANDLE>(mapping));
+    }
+  #elif defined(MEMORYSTORM_STATS_SEGMENT_SUPPORTED)
+    if(segment) {
+      munmap(segment, sizeof(detail::stats_segment));
+      shm_unlink(name.c_str());
+    }
+  #endif // platform selection
+}
+
+bool stats_publisher::open() {
+  /// Create and map this process's segment, replacing any left behind by a crashed process with the same PID; fails if another user holds the name
+  if(segment) {
+    return true;
+  }
+  uint32_t const pid{get_current_pid()};
+  name = get_stats_segment_name(pid);
+  void *memory{nullptr};
+  #if defined(PLATFORM_WINDOWS)
+    HANDLE const handle{CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(detail::stats_segment), name.c_str())};
+    if(!handle) {
+      return false;
+    }
+    memory = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(detail::stats_segment));
+    if(!memory) {
+      CloseHandle(handle);
+      return false;
+    }
+    mapping = handle;
+  #elif defined(MEMORYSTORM_STATS_SEGMENT_SUPPORTED)
+    shm_unlink(name.c_str());                                                   // left by a crashed process with this PID; if another user owns it, this fails and so does the exclusive create
+    int const fd{shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR)};
+    if(fd < 0) {
+      return false;
+    }
+    struct stat status{};
+    if(fstat(fd, &status) != 0 || status.st_uid != geteuid() ||
+       fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0 ||                // world-readable, so monitors needn't run as this user; set explicitly, as the umask applies at creation
+       ftruncate(fd, sizeof(detail::stats_segment)) != 0) {
+      close(fd);
+      shm_unlink(name.c_str());
+      return false;
+    }
+    memory = mmap(nullptr, sizeof(detail::stats_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED) {
+      shm_unlink(name.c_str());
+      return false;
+    }
+  #else
+    (void)pid;
+    return false;
+  #endif // platform selection
+  segment = new(memory) detail::stats_segment{};
+  segment->version = segment_version;
+  segment->size = sizeof(detail::stats_segment);
+  segment->pid = pid;
+  segment->magic.store(segment_magic, std::memory_order_release);
+  return true;
+}
+
+bool stats_publisher::is_open() const {
+  /// Whether the segment has been created
+  return segment != nullptr;
+}
+
+std::string const &stats_publisher::get_name() const {
+  /// Name of the segment, empty until opened
+  return name;
+}
+
+void stats_publisher::publish(snapshot const &memory) {
+  /// Write a snapshot under the seqlock; call from one thread at a time
+  if(!segment) {
+    return;
+  }
+  uint64_t const sequence{segment->sequence.load(std::memory_order_relaxed)};
+  segment->sequence.store(sequence + 1, std::memory_order_relaxed);             // odd: write in progress
+  std::atomic_thread_fence(std::memory_order_release);
+  segment->time.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+  for(size_t i{0}; i != detail::stats_segment_values; ++i) {
+    segment->values[i].store(memory.*detail::snapshot_members[i].member, std::memory_order_relaxed);
+  }
+  segment->updates.store(segment->updates.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  segment->sequence.store(sequence + 2, std::memory_order_release);             // even: write complete
+}
+
+void stats_publisher::publish() {
+  /// Take and publish a snapshot now
+  publish(take_snapshot(fields));
+}
+
+bool stats_publisher::start() {
+  /// Open the segment if needed, publish once synchronously, then keep publishing in the background
+  if(worker.running()) {
+    return true;
+  }
+  if(!open()) {
+    return false;
+  }
+  publish();
+  worker.start(interval, [this]{ publish(); });
+  return true;
+}
+
+void stats_publisher::stop() {
+  /// Stop and join the publishing thread; the segment stays readable until destruction
+  worker.stop();
+}
+
+bool stats_publisher::running() const {
+  /// Whether the publishing thread is active
+  return worker.running();
+}
+
+stats_reader::stats_reader(uint32_t this_pid)
+  : pid{this_pid} {
+  /// Attach read-only to a process's segment; check attached() for success
+  std::string const name{get_stats_segment_name(pid)};
+  #if defined(PLATFORM_WINDOWS)
+    HANDLE const handle{OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str())};
+    if(!handle) {
+      return;
+    }
+    void *const memory{MapViewOfFile(handle, FILE_MAP_READ, 0, 0, sizeof(detail::stats_segment))};
+    if(!memory) {
+      CloseHandle(handle);
+      return;
+    }
+    mapping = handle;
+    segment = static_cast<detail::stats_segment const*>(memory);
+  #elif defined(MEMORYSTORM_STATS_SEGMENT_SUPPORTED)
+    int const fd{shm_open(name.c_str(), O_RDONLY, 0)};
+    if(fd < 0) {
+      return;
+    }
+    struct stat status{};
+    if(fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(detail::stats_segment)) {
+      close(fd);
+      return;                                                                   // not created yet, or from an incompatible version
+    }
+    #if defined(PLATFORM_LINUX)
+      struct stat process{};
+      std::string const process_path{"/proc/" + std::to_string(pid)};
+      if(stat(process_path.c_str(), &process) != 0 || process.st_uid != status.st_uid) {
+        close(fd);
+        return;                                                                 // not created by the user running that process, so not to be trusted
+      }
+    #endif // defined(PLATFORM_LINUX)
+    void *const memory{mmap(nullptr, sizeof(detail::stats_segment), PROT_READ, MAP_SHARED, fd, 0)};
+    close(fd);
+    if(memory == MAP_FAILED) {
+      return;
+    }
+    segment = static_cast<detail::stats_segment const*>(memory);
+  #endif // platform selection
+}
+
+stats_reader::~stats_reader() {
+  #if defined(PLATFORM_WINDOWS)
+    if(segment) {
+      UnmapViewOfFile(segment);
+      CloseHandle(static_cast<HANDLE>(mapping));
+    }
+  #elif defined(MEMORYSTORM_STATS_SEGMENT_SUPPORTED)
+    if(segment) {
+      munmap(const_cast<detail::stats_segment*>(segment), sizeof(detail::stats_segment));
+    }
+  #endif // platform selection
+}
+
+bool stats_reader::attached() const {
+  /// Whether the segment was found and mapped
+  return segment != nullptr;
+}
+
+bool stats_reader::read(published_stats &out) const {
+  /// Copy the latest snapshot without involving the publisher; false if unavailable, incompatible or never published
+  if(!segment ||
+     segment->magic.load(std::memory_order_acquire) != segment_magic ||
+     segment->version != segment_version ||
+     segment->size != sizeof(detail::stats_segment) ||
+     segment->pid != pid) {
+    return false;
+  }
+  for(unsigned int attempt{0}; attempt != max_read_attempts; ++attempt) {
+    uint64_t const sequence_before{segment->sequence.load(std::memory_order_acquire)};
+    if(sequence_before & 1u) {
+      continue;                                                                 // publisher is mid-update, retry
+    }
+    uint64_t const updates{segment->updates.load(std::memory_order_relaxed)};
+    int64_t const time{segment->time.load(std::memory_order_relaxed)};
+    uint64_t values[detail::stats_segment_values];
+    for(size_t i{0}; i != detail::stats_segment_values; ++i) {
+      values[i] = segment->values[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(segment->sequence.load(std::memory_order_relaxed) != sequence_before) {
+      continue;                                                                 // torn read, retry
+    }
+    if(updates == 0) {
+      return false;
+    }
+    out.pid = pid;
+    out.updates = updates;
+    out.time = std::chrono::steady_clock::time_point{std::chrono::steady_clock::duration{time}};
+    for(size_t i{0}; i != detail::stats_segment_values; ++i) {
+      out.memory.*detail::snapshot_members[i].member = values[i];
+    }
+    return true;
+  }
+  return false;
+}
+
+}
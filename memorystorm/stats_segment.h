@@ -0,0 +1,73 @@
+#pragma once
+
+/// Publishing snapshots into a named shared memory segment, so external monitors can read them without IPC
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "memorystorm.h"
+#include "periodic_worker.h"
+
+namespace memorystorm {
+
+namespace detail {
+struct stats_segment;
+}
+
+struct published_stats {
+  /// The latest snapshot read from another process's segment
+  uint32_t pid{0};
+  uint64_t updates{0};                                                          // number of snapshots published so far
+  std::chrono::steady_clock::time_point time{};                                 // when the snapshot was taken; the steady clock is system-wide
+  snapshot memory{};
+};
+
+std::string get_stats_segment_name(uint32_t pid);
+
+class stats_publisher {
+  /// Owns this process's segment; publishing is a seqlocked write, so readers never block the publisher
+  detail::stats_segment *segment{nullptr};
+  void *mapping{nullptr};                                                       // file mapping handle on Windows
+  std::string name;
+  uint32_t const fields;
+  std::chrono::nanoseconds const interval;
+
+  detail::periodic_worker worker;
+
+public:
+  explicit stats_publisher(std::chrono::nanoseconds interval = std::chrono::milliseconds{100},
+                           uint32_t fields = field::system | field::process); // stack_available would only measure the publishing thread's own stack
+  stats_publisher(stats_publisher const&) = delete;
+  stats_publisher &operator=(stats_publisher const&) = delete;
+  ~stats_publisher();
+
+  bool open();
+  bool is_open() const;
+  std::string const &get_name() const;
+
+  void publish();
+  void publish(snapshot const &memory);
+
+  bool start();
+  void stop();
+  bool running() const;
+};
+
+class stats_reader {
+  /// Read-only view of another process's segment
+  detail::stats_segment const *segment{nullptr};
+  void *mapping{nullptr};                                                       // file mapping handle on Windows
+  uint32_t const pid;
+
+public:
+  explicit stats_reader(uint32_t pid);
+  stats_reader(stats_reader const&) = delete;
+  stats_reader &operator=(stats_reader const&) = delete;
+  ~stats_reader();
+
+  bool attached() const;
+  bool read(published_stats &out) const;
+};
+
+}
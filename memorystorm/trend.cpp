@@ -0,0 +1,169 @@
+#include "trend.h"
+#include <algorithm>
+#include <cmath>
+#include "cgroup.h"
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+namespace {
+
+double get_slope(double weight, double sum_t, double sum_tt, double sum_y, double sum_ty) {
+  /// Weighted least-squares slope; zero until there are at least two distinct sample times
+  double const denominator{weight * sum_tt - sum_t * sum_t};
+  if(!(denominator > 1e-9 * weight * weight)) {
+    return 0.0;
+  }
+  return (weight * sum_ty - sum_t * sum_y) / denominator;
+}
+
+}
+
+trend_analyser::trend_analyser(std::vector<std::chrono::seconds> windows, bool this_track_heap)
+  : track_heap{this_track_heap} {
+  std::sort(windows.begin(), windows.end());
+  for(auto const window : windows) {
+    window_state state{};
+    state.tau = static_cast<double>(std::max(window.count(), std::chrono::seconds::rep{1}));
+    states.emplace_back(state);
+    trend_window_estimate estimate{};
+    estimate.window = window;
+    report.windows.emplace_back(estimate);
+  }
+}
+
+trend_analyser::~trend_analyser() {
+  stop();
+}
+
+void trend_analyser::set_min_growth_rate(double bytes_per_second) {
+  /// Growth slower than this, in bytes per second, never counts as sustained
+  std::lock_guard<std::mutex> lock{state_mutex};
+  min_growth_rate = bytes_per_second;
+}
+
+void trend_analyser::set_warning(std::chrono::seconds horizon, callback function) {
+  /// Call back once when sustained growth would exhaust memory within the horizon; re-armed when that stops being true
+  std::lock_guard<std::mutex> lock{state_mutex};
+  warning_horizon = horizon;
+  warning = std::move(function);
+  warned = false;
+}
+
+trend_report trend_analyser::check() {
+  /// Sample RSS, headroom and (if tracked) live heap bytes now, and update the trend
+  uint64_t const heap_bytes{track_heap ? get_alloc_stats().live_bytes() : 0};
+  return check(std::chrono::steady_clock::now(), get_physical_usage(), get_effective_physical_available(), heap_bytes);
+}
+
+trend_report trend_analyser::check(std::chrono::steady_clock::time_point time, uint64_t rss, uint64_t headroom, uint64_t heap_bytes) {
+  /// Add a sample supplied by the caller; samples must arrive in time order
+  std::lock_guard<std::mutex> lock{state_mutex};
+  if(!has_samples) {
+    has_samples = true;
+    first_time = time;
+    report.time = time;
+    origin[0] = static_cast<double>(rss);
+    origin[1] = static_cast<double>(heap_bytes);
+  }
+  double const dt{std::max(std::chrono::duration<double>{time - report.time}.count(), 0.0)};
+  double const y[2]{static_cast<double>(rss) - origin[0], static_cast<double>(heap_bytes) - origin[1]};
+  double const elapsed{std::chrono::duration<double>{time - first_time}.count()};
+  report.time = time;
+  report.rss = rss;
+  report.heap_bytes = heap_bytes;
+  report.headroom = headroom;
+  report.bytes_per_second = 0.0;
+  report.sustained_growth = !states.empty();
+  report.sustained_heap_growth = track_heap && !states.empty();
+  double agreed_rate{0.0};
+  for(size_t i{0}; i != states.size(); ++i) {
+    window_state &state{states[i]};
+    double const decay{std::exp(-dt / state.tau)};
+    state.weight *= decay;
+    state.sum_t *= decay;
+    state.sum_tt *= decay;
+    for(size_t series{0}; series != 2; ++series) {
+      state.sum_y[series] *= decay;
+      state.sum_ty[series] *= decay;
+      state.sum_ty[series] -= dt * state.sum_y[series];                         // move the time origin to the new sample
+      state.sum_y[series] += y[series];
+    }
+    state.sum_tt += dt * (dt * state.weight - 2.0 * state.sum_t);
+    state.sum_t -= dt * state.weight;
+    state.weight += 1.0;
+
+    trend_window_estimate &estimate{report.windows[i]};
+    estimate.covered = elapsed >= state.tau;
+    estimate.rss_bytes_per_second = get_slope(state.weight, state.sum_t, state.sum_tt, state.sum_y[0], state.sum_ty[0]);
+    estimate.heap_bytes_per_second = track_heap ? get_slope(state.weight, state.sum_t, state.sum_tt, state.sum_y[1], state.sum_ty[1]) : 0.0;
+    if(estimate.covered || i == 0) {
+      report.bytes_per_second = estimate.rss_bytes_per_second;
+    }
+    bool const rss_growing{estimate.covered && estimate.rss_bytes_per_second > min_growth_rate};
+    report.sustained_growth = report.sustained_growth && rss_growing;
+    report.sustained_heap_growth = report.sustained_heap_growth && estimate.covered && estimate.heap_bytes_per_second > min_growth_rate;
+    agreed_rate = i == 0 ? estimate.rss_bytes_per_second : std::min(agreed_rate, estimate.rss_bytes_per_second);
+  }
+  report.time_to_exhaustion = std::chrono::seconds::max();
+  if(report.sustained_growth && agreed_rate > 0.0) {
+    double const seconds{static_cast<double>(headroom) / agreed_rate};
+    if(seconds < static_cast<double>(std::chrono::seconds::max().count())) {
+      report.time_to_exhaustion = std::chrono::seconds{static_cast<std::chrono::seconds::rep>(seconds)};
+    }
+  }
+  bool const warning_due{report.sustained_growth && report.time_to_exhaustion <= warning_horizon};
+  if(warning_due && !warned && warning) {
+    warning(report);
+  }
+  warned = warning_due;
+  return report;
+}
+
+trend_report trend_analyser::get_report() const {
+  /// The trend as of the last check
+  std::lock_guard<std::mutex> lock{state_mutex};
+  return report;
+}
+
+void trend_analyser::reset() {
+  /// Forget all samples, e.g. after deliberately freeing caches or changing workload
+  std::lock_guard<std::mutex> lock{state_mutex};
+  for(auto &state : states) {
+    double const tau{state.tau};
+    state = window_state{};
+    state.tau = tau;
+  }
+  for(auto &estimate : report.windows) {
+    estimate.covered = false;
+    estimate.rss_bytes_per_second = 0.0;
+    estimate.heap_bytes_per_second = 0.0;
+  }
+  has_samples = false;
+  warned = false;
+  report.bytes_per_second = 0.0;
+  report.sustained_growth = false;
+  report.sustained_heap_growth = false;
+  report.time_to_exhaustion = std::chrono::seconds::max();
+}
+
+void trend_analyser::start(std::chrono::nanoseconds interval) {
+  /// Sample on a background thread at the given interval, as an alternative to calling check() from your own tick
+  if(worker.running()) {
+    return;
+  }
+  check();
+  worker.start(interval, [this]{ check(); });
+}
+
+void trend_analyser::stop() {
+  /// Stop the background sampling thread
+  worker.stop();
+}
+
+bool trend_analyser::running() const {
+  /// Whether the background sampling thread is active
+  return worker.running();
+}
+
+}
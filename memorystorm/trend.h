@@ -0,0 +1,85 @@
+#pragma once
+
+/// Online growth trend analysis of memory usage, for spotting slow leaks and predicting when memory runs out
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "periodic_worker.h"
+
+namespace memorystorm {
+
+struct trend_window_estimate {
+  /// Growth over one time window, from an exponentially weighted least-squares fit with the window as its time constant
+  std::chrono::seconds window{0};
+  bool covered{false};                                                          // samples span at least the whole window
+  double rss_bytes_per_second{0.0};
+  double heap_bytes_per_second{0.0};                                            // zero unless heap tracking is enabled
+};
+
+struct trend_report {
+  /// The state of the analyser as of its latest sample
+  std::chrono::steady_clock::time_point time{};
+  uint64_t rss{0};
+  uint64_t heap_bytes{0};
+  uint64_t headroom{0};                                                         // bytes left before the effective (cgroup) limit
+  std::vector<trend_window_estimate> windows;
+  double bytes_per_second{0.0};                                                 // RSS growth over the longest window with enough samples
+  bool sustained_growth{false};                                                 // RSS grew over every window, each fully covered
+  bool sustained_heap_growth{false};
+  std::chrono::seconds time_to_exhaustion{std::chrono::seconds::max()};         // at the slowest growth rate every window agrees on
+};
+
+class trend_analyser {
+  /// Constant-memory regression of RSS (and optionally live heap bytes) over several windows, with an early warning callback
+public:
+  using callback = std::function<void(trend_report const &report)>;
+
+private:
+  struct window_state {
+    double tau{0.0};                                                            // window length in seconds
+    double weight{0.0};                                                         // decayed sums, with times relative to the latest sample
+    double sum_t{0.0};
+    double sum_tt{0.0};
+    double sum_y[2]{};                                                          // RSS and heap, relative to their first samples
+    double sum_ty[2]{};
+  };
+
+  bool const track_heap;
+  std::vector<window_state> states;
+  double min_growth_rate{0.0};
+  std::chrono::seconds warning_horizon{0};
+  callback warning;
+  bool warned{false};
+  bool has_samples{false};
+  std::chrono::steady_clock::time_point first_time{};
+  double origin[2]{};
+  trend_report report{};
+  mutable std::mutex state_mutex;                                               // held while checking and dispatching, so the callback must not call back in
+
+  detail::periodic_worker worker;
+
+public:
+  explicit trend_analyser(std::vector<std::chrono::seconds> windows = {std::chrono::minutes{1}, std::chrono::minutes{10}, std::chrono::hours{1}},
+                          bool track_heap = false);
+  trend_analyser(trend_analyser const&) = delete;
+  trend_analyser &operator=(trend_analyser const&) = delete;
+  ~trend_analyser();
+
+  void set_min_growth_rate(double bytes_per_second);
+  void set_warning(std::chrono::seconds horizon, callback function);
+
+  trend_report check();
+  trend_report check(std::chrono::steady_clock::time_point time, uint64_t rss, uint64_t headroom, uint64_t heap_bytes = 0);
+  trend_report get_report() const;
+  void reset();
+
+  void start(std::chrono::nanoseconds interval);
+  void stop();
+  bool running() const;
+};
+
+}
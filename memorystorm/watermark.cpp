@@ -0,0 +1,178 @@
+#include "watermark.h"
+#include <algorithm>
+#include <utility>
+#include "cgroup.h"
+#include "memorystorm.h"
+
+namespace memorystorm {
+
+watermark_threshold watermark_threshold::bytes(uint64_t amount) {
+  /// Threshold at a fixed number of bytes
+  return {basis::bytes, static_cast<double>(amount)};
+}
+watermark_threshold watermark_threshold::percent_of_total(double percent) {
+  /// Threshold at a percentage of total physical memory
+  return {basis::fraction_of_total, percent / 100.0};
+}
+watermark_threshold watermark_threshold::percent_of_limit(double percent) {
+  /// Threshold at a percentage of the effective limit, which is the cgroup limit inside a container
+  return {basis::fraction_of_limit, percent / 100.0};
+}
+
+watermarks::watermarks(double this_hysteresis)
+  : hysteresis{this_hysteresis} {
+  threshold_bytes.fill(unlimited);
+}
+
+watermarks::~watermarks() {
+  stop();
+}
+
+std::array<uint64_t, watermarks::level_count> watermarks::resolve(std::array<watermark_threshold, level_count> const &targets) const {
+  /// Convert relative thresholds to bytes; done when thresholds change rather than on every check
+  std::array<uint64_t, level_count> result{};
+  uint64_t total{0};
+  uint64_t limit{0};
+  for(size_t i{0}; i != level_count; ++i) {
+    auto const &threshold{targets[i]};
+    switch(threshold.type) {
+    case watermark_threshold::basis::none:
+      result[i] = unlimited;
+      break;
+    case watermark_threshold::basis::bytes:
+      result[i] = static_cast<uint64_t>(threshold.value);
+      break;
+    case watermark_threshold::basis::fraction_of_total:
+      if(total == 0) {
+        total = get_physical_total();
+      }
+      result[i] = static_cast<uint64_t>(static_cast<double>(total) * threshold.value);
+      break;
+    case watermark_threshold::basis::fraction_of_limit:
+      if(limit == 0) {
+        limit = get_effective_physical_total();
+      }
+      result[i] = static_cast<uint64_t>(static_cast<double>(limit) * threshold.value);
+      break;
+    }
+  }
+  return result;
+}
+
+bool watermarks::set_threshold(watermark_level this_level, watermark_threshold threshold) {
+  /// Set the threshold at which a level is entered; refused for normal, or if the set thresholds would no longer rise with the level
+  if(this_level == watermark_level::normal) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock{state_mutex};
+  auto targets{thresholds};
+  targets[static_cast<size_t>(this_level)] = threshold;
+  auto const resolved{resolve(targets)};
+  uint64_t below{0};
+  for(uint64_t const bytes : resolved) {
+    if(bytes == unlimited) {
+      continue;                                                                 // unset levels don't constrain the others
+    }
+    if(bytes < below) {
+      return false;
+    }
+    below = bytes;
+  }
+  thresholds = targets;
+  threshold_bytes = resolved;
+  return true;
+}
+
+uint64_t watermarks::get_threshold(watermark_level this_level) const {
+  /// The resolved threshold for a level in bytes, or unlimited if unset
+  std::lock_guard<std::mutex> lock{state_mutex};
+  return threshold_bytes[static_cast<size_t>(this_level)];
+}
+
+void watermarks::add_callback(watermark_level this_level, callback function, int priority) {
+  /// Register a callback for when usage rises into a level (or falls back to normal); higher priorities are called first
+  std::lock_guard<std::mutex> lock{state_mutex};
+  auto &registrations{callbacks[static_cast<size_t>(this_level)]};
+  registrations.emplace_back(registration{priority, std::move(function)});
+  std::stable_sort(registrations.begin(), registrations.end(), [](registration const &lhs, registration const &rhs){
+    return lhs.priority > rhs.priority;
+  });
+}
+
+void watermarks::refresh_limits() {
+  /// Re-resolve relative thresholds, e.g. after a cgroup limit change
+  std::lock_guard<std::mutex> lock{state_mutex};
+  threshold_bytes = resolve(thresholds);
+}
+
+watermark_level watermarks::check() {
+  /// Sample physical usage and update the level
+  return check(get_physical_usage());
+}
+
+watermark_level watermarks::check(uint64_t usage) {
+  /// Update the level from a usage figure supplied by the caller, calling back for each level entered on the way up, or for normal on recovery
+  std::vector<std::pair<watermark_level, callback>> pending;                    // copied under the lock and called after it, so callbacks may use this object
+  watermark_level result{watermark_level::normal};
+  {
+    std::lock_guard<std::mutex> lock{state_mutex};
+    auto const previous{static_cast<size_t>(level.load(std::memory_order_relaxed))};
+    size_t target{0};
+    for(size_t i{level_count - 1}; i != 0; --i) {
+      if(threshold_bytes[i] != unlimited && usage >= threshold_bytes[i]) {      // unset levels in between don't stop the climb
+        target = i;
+        break;
+      }
+    }
+    if(target > previous) {
+      for(size_t i{previous + 1}; i <= target; ++i) {
+        if(threshold_bytes[i] == unlimited) {
+          continue;
+        }
+        for(auto const &entry : callbacks[i]) {
+          pending.emplace_back(static_cast<watermark_level>(i), entry.function);
+        }
+      }
+    } else {
+      target = previous;
+      while(target != 0 &&
+            (threshold_bytes[target] == unlimited ||
+             static_cast<double>(usage) < static_cast<double>(threshold_bytes[target]) * (1.0 - hysteresis))) { // only drop once comfortably below, so callbacks don't flap
+        --target;
+      }
+      if(target == 0 && previous != 0) {                                        // shedding callbacks only run on the way up
+        for(auto const &entry : callbacks[0]) {
+          pending.emplace_back(watermark_level::normal, entry.function);
+        }
+      }
+    }
+    result = static_cast<watermark_level>(target);
+    level.store(result, std::memory_order_relaxed);
+  }
+  for(auto const &[entered, function] : pending) {
+    function(entered, usage);
+  }
+  return result;
+}
+
+watermark_level watermarks::get_level() const {
+  /// The level as of the last check
+  return level.load(std::memory_order_relaxed);
+}
+
+void watermarks::start(std::chrono::nanoseconds interval) {
+  /// Check usage on a background thread at the given interval, as an alternative to calling check() from your own tick
+  worker.start(interval, [this]{ check(); });
+}
+
+void watermarks::stop() {
+  /// Stop the background checking thread
+  worker.stop();
+}
+
+bool watermarks::running() const {
+  /// Whether the background checking thread is active
+  return worker.running();
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+/// Memory watermarks with prioritised callbacks, for declaring cache shedding policy in one place
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "periodic_worker.h"
+
+namespace memorystorm {
+
+enum class watermark_level : uint8_t {
+  normal,
+  low,
+  high,
+  critical
+};
+
+struct watermark_threshold {
+  /// A usage threshold, as absolute bytes or relative to the system total or the effective (cgroup) limit
+  enum class basis : uint8_t {
+    none,
+    bytes,
+    fraction_of_total,
+    fraction_of_limit
+  };
+  basis type{basis::none};
+  double value{0.0};
+
+  static watermark_threshold bytes(uint64_t amount);
+  static watermark_threshold percent_of_total(double percent);
+  static watermark_threshold percent_of_limit(double percent);
+};
+
+class watermarks {
+  /// Tracks physical usage against low, high and critical thresholds with hysteresis, calling back on each level entered on the way up and on recovery to normal
+public:
+  using callback = std::function<void(watermark_level level, uint64_t usage)>;
+
+private:
+  static size_t constexpr level_count{4};
+  struct registration {
+    int priority{0};
+    callback function;
+  };
+
+  double const hysteresis;
+  std::array<watermark_threshold, level_count> thresholds{};
+  std::array<uint64_t, level_count> threshold_bytes{};                          // thresholds resolved to bytes, unlimited if unset
+  std::array<std::vector<registration>, level_count> callbacks{};
+  std::atomic<watermark_level> level{watermark_level::normal};
+  mutable std::mutex state_mutex;                                               // guards thresholds, registrations and level changes; released before callbacks run
+
+  detail::periodic_worker worker;
+
+  std::array<uint64_t, level_count> resolve(std::array<watermark_threshold, level_count> const &targets) const;
+
+public:
+  explicit watermarks(double hysteresis = 0.05);
+  watermarks(watermarks const&) = delete;
+  watermarks &operator=(watermarks const&) = delete;
+  ~watermarks();
+
+  bool set_threshold(watermark_level level, watermark_threshold threshold);
+  uint64_t get_threshold(watermark_level level) const;
+  void add_callback(watermark_level level, callback function, int priority = 0);
+  void refresh_limits();
+
+  watermark_level check();
+  watermark_level check(uint64_t usage);
+  watermark_level get_level() const;
+
+  void start(std::chrono::nanoseconds interval);
+  void stop();
+  bool running() const;
+};
+
+}
@@ -0,0 +1,399 @@
+/// Micro-benchmarks for the public queries: nanoseconds and heap allocations per call, single-threaded and under contention
+///
+/// usage: memorystorm_bench [--threads N] [--min-time MS] [--filter TEXT] [--format text|csv|json]
+///                          [--output FILE] [--baseline FILE] [--tolerance PERCENT]
+///
+/// Save a baseline with --format csv --output FILE, then pass it back with --baseline to fail on regressions.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "cgroup.h"
+#include "export.h"
+#include "heap.h"
+#include "heap_profiler.h"
+#include "hugepages.h"
+#include "memorystorm.h"
+#include "numa.h"
+#include "peak.h"
+#include "pool.h"
+#include "pressure.h"
+#include "process.h"
+#include "residency.h"
+#include "sampler.h"
+#include "scope_tag.h"
+#include "smaps.h"
+#include "stats_segment.h"
+#include "trend.h"
+#include "watermark.h"
+
+using namespace memorystorm;
+
+namespace {
+
+template<typename T>
+void keep(T const &value) {
+  /// Stop the optimiser discarding a result
+  #if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+  #else
+    static void const *volatile sink;
+    sink = &value;
+  #endif
+}
+
+struct benchmark {
+  std::string name;
+  std::function<void(uint64_t iterations)> run;
+  bool thread_safe{true};                                                       // false for objects that must only be used from one thread
+};
+
+template<typename Function>
+benchmark make_benchmark(std::string name, Function function, bool thread_safe = true) {
+  /// Wrap a single call in a loop, so the indirect call is paid once per batch rather than once per call
+  return {std::move(name), [function](uint64_t iterations) mutable {
+    for(uint64_t i{0}; i != iterations; ++i) {
+      keep(function());
+    }
+  }, thread_safe};
+}
+
+struct result {
+  std::string name;
+  unsigned int threads{1};
+  double ns_per_call{0.0};
+  double allocations_per_call{0.0};
+  uint64_t iterations{0};
+};
+
+struct options {
+  unsigned int threads{4};
+  std::chrono::milliseconds min_time{100};
+  std::string filter;
+  std::string format{"text"};
+  std::string output;
+  std::string baseline;
+  double tolerance{25.0};                                                       // percent slower than the baseline before it counts as a regression
+};
+
+double time_ns(std::function<void(uint64_t)> const &run, uint64_t iterations) {
+  auto const start{std::chrono::steady_clock::now()};
+  run(iterations);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint64_t calibrate(benchmark const &bench, std::chrono::milliseconds min_time) {
+  /// Find an iteration count that runs for roughly min_time
+  double const target_ns{std::max(1.0, static_cast<double>(std::chrono::nanoseconds{min_time}.count()))};
+  uint64_t iterations{1};
+  while(true) {
+    double const elapsed{time_ns(bench.run, iterations)};
+    if(elapsed >= target_ns / 10.0 || iterations >= uint64_t{1} << 32) {
+      return std::max<uint64_t>(1, static_cast<uint64_t>(static_cast<double>(iterations) * target_ns / std::max(elapsed, 1.0)));
+    }
+    iterations *= 10;
+  }
+}
+
+result measure_single(benchmark const &bench, uint64_t iterations) {
+  /// Best of three runs, to filter out scheduling noise
+  result measured{bench.name, 1, 0.0, 0.0, iterations};
+  double best{0.0};
+  for(unsigned int repeat{0}; repeat != 3; ++repeat) {
+    double const elapsed{time_ns(bench.run, iterations)};
+    best = repeat == 0 ? elapsed : std::min(best, elapsed);
+  }
+  measured.ns_per_call = best / static_cast<double>(iterations);
+  auto const before{get_alloc_stats()};
+  bench.run(iterations);
+  auto const after{get_alloc_stats()};
+  measured.allocations_per_call = static_cast<double>(after.allocations - before.allocations) / static_cast<double>(iterations);
+  return measured;
+}
+
+result measure_contended(benchmark const &bench, uint64_t iterations, unsigned int thread_count) {
+  /// Every thread runs the same number of calls at once; reports the mean per-call time seen by each thread
+  std::atomic<unsigned int> ready{0};
+  std::atomic<bool> go{false};
+  std::atomic<unsigned int> done{0};
+  std::vector<double> elapsed(thread_count, 0.0);
+  std::vector<std::thread> threads;
+  for(unsigned int index{0}; index != thread_count; ++index) {
+    threads.emplace_back([&, index]{
+      ready.fetch_add(1, std::memory_order_acq_rel);
+      while(!go.load(std::memory_order_acquire)) {}
+      elapsed[index] = time_ns(bench.run, iterations);
+      done.fetch_add(1, std::memory_order_acq_rel);
+    });
+  }
+  while(ready.load(std::memory_order_acquire) != thread_count) {}
+  auto const before{get_alloc_stats()};                                         // counted between the barriers, so thread creation and exit are left out
+  go.store(true, std::memory_order_release);
+  while(done.load(std::memory_order_acquire) != thread_count) {}
+  auto const after{get_alloc_stats()};
+  for(auto &thread : threads) {
+    thread.join();
+  }
+  double total{0.0};
+  for(double const value : elapsed) {
+    total += value;
+  }
+  double const calls{static_cast<double>(iterations) * thread_count};
+  return {bench.name, thread_count, total / calls, static_cast<double>(after.allocations - before.allocations) / calls, iterations};
+}
+
+std::vector<benchmark> make_benchmarks() {
+  /// One entry per public query; objects the queries need are created once and shared
+  static std::vector<char> resident(1024 * 1024, 1);
+  static std::string const pressure_path{get_memory_pressure_path()};
+  static sampler background{std::chrono::milliseconds{10}};
+  static watermarks marks;
+  static trend_analyser trends;
+  static arena frame{"bench_arena"};
+  static pool<uint64_t> values{"bench_pool"};
+  static uint64_t const usage{get_physical_usage()};
+  static uint32_t const tag{register_tag("bench")};
+  static snapshot const current{take_snapshot()};
+  static std::vector<uint32_t> const tree{get_process_tree()};
+  static stats_publisher publisher;
+  static stats_reader const reader{[]{publisher.open(); publisher.publish(); return get_current_process_id();}()};
+  background.start();
+
+  std::vector<benchmark> result;
+  result.emplace_back(make_benchmark("get_stack_available",           []{return get_stack_available();}));
+  result.emplace_back(make_benchmark("get_physical_total",            []{return get_physical_total();}));
+  result.emplace_back(make_benchmark("get_physical_available",        []{return get_physical_available();}));
+  result.emplace_back(make_benchmark("get_physical_available_reclaimable", []{return get_physical_available(available_mode::reclaimable);}));
+  result.emplace_back(make_benchmark("get_physical_usage",            []{return get_physical_usage();}));
+  result.emplace_back(make_benchmark("get_virtual_total",             []{return get_virtual_total();}));
+  result.emplace_back(make_benchmark("get_virtual_available",         []{return get_virtual_available();}));
+  result.emplace_back(make_benchmark("get_virtual_usage",             []{return get_virtual_usage();}));
+  result.emplace_back(make_benchmark("take_snapshot",                 []{return take_snapshot();}));
+  result.emplace_back(make_benchmark("take_snapshot_process",         []{return take_snapshot(field::process);}));
+  result.emplace_back(make_benchmark("get_meminfo",                   []{return get_meminfo();}));
+  result.emplace_back(make_benchmark("get_alloc_stats",               []{return get_alloc_stats();}));
+  result.emplace_back(make_benchmark("human_readable",                []{return human_readable(123'456'789);}));
+  result.emplace_back(make_benchmark("human_readable_to",             []{
+    char buffer[human_readable_max_length];
+    return human_readable_to(123'456'789, buffer, sizeof(buffer));
+  }));
+  result.emplace_back(make_benchmark("write_json",                    []{
+    char buffer[4096];
+    return write_json(buffer, sizeof(buffer), current);
+  }));
+  result.emplace_back(make_benchmark("write_prometheus",              []{
+    char buffer[4096];
+    return write_prometheus(buffer, sizeof(buffer), current);
+  }));
+  result.emplace_back(make_benchmark("write_csv",                     []{
+    char buffer[4096];
+    return write_csv(buffer, sizeof(buffer), current);
+  }));
+  result.emplace_back(make_benchmark("get_stats",                     []{return get_stats();}));
+  result.emplace_back(make_benchmark("get_cgroup_memory_max",         []{return get_cgroup_memory_max();}));
+  result.emplace_back(make_benchmark("get_cgroup_memory_high",        []{return get_cgroup_memory_high();}));
+  result.emplace_back(make_benchmark("get_cgroup_memory_current",     []{return get_cgroup_memory_current();}));
+  result.emplace_back(make_benchmark("get_cgroup_swap_max",           []{return get_cgroup_swap_max();}));
+  result.emplace_back(make_benchmark("get_cgroup_memory_stat",        []{return get_cgroup_memory_stat();}));
+  result.emplace_back(make_benchmark("get_effective_physical_total",  []{return get_effective_physical_total();}));
+  result.emplace_back(make_benchmark("get_effective_physical_available", []{return get_effective_physical_available();}));
+  result.emplace_back(make_benchmark("get_memory_pressure",           []{return get_memory_pressure(pressure_path);}));
+  result.emplace_back(make_benchmark("get_process_memory",            []{return get_process_memory(get_current_process_id());}));
+  result.emplace_back(make_benchmark("get_process_tree",              []{return get_process_tree();}));
+  result.emplace_back(make_benchmark("get_process_tree_memory",       []{return get_process_tree_memory();}));
+  result.emplace_back(make_benchmark("get_top_processes",             []{return get_top_processes(tree, 5);}));
+  result.emplace_back(make_benchmark("get_smaps_rollup",              []{return get_smaps_rollup();}));
+  result.emplace_back(make_benchmark("get_mappings",                  []{return get_mappings();}));
+  result.emplace_back(make_benchmark("get_top_mappings",              []{return get_top_mappings();}));
+  result.emplace_back(make_benchmark("get_huge_page_status",          []{return get_huge_page_status();}));
+  result.emplace_back(make_benchmark("get_numa_meminfo",              []{return get_numa_meminfo();}));
+  result.emplace_back(make_benchmark("get_process_numa_memory",       []{return get_process_numa_memory();}));
+  result.emplace_back(make_benchmark("get_page_nodes_1MB",            []{return get_page_nodes(resident.data(), resident.size());}));
+  result.emplace_back(make_benchmark("get_residency_1MB",             []{return get_residency(resident.data(), resident.size());}));
+  result.emplace_back(make_benchmark("get_tag_stats",                 []{return get_tag_stats();}));
+  result.emplace_back(make_benchmark("scope_tag",                     []{scope_tag scope{tag}; return get_current_tag();}));
+  result.emplace_back(make_benchmark("get_heap_stats",                []{return get_heap_stats();}));
+  result.emplace_back(make_benchmark("release_free_heap",             []{return release_free_heap();}));
+  result.emplace_back(make_benchmark("get_allocator_stats",           []{return get_allocator_stats();}));
+  result.emplace_back(make_benchmark("get_heap_profile_sample_count", []{return get_heap_profile_sample_count();}));
+  result.emplace_back(make_benchmark("sampler_latest",                []{return background.latest();}));
+  result.emplace_back(make_benchmark("watermarks_check",              []{return marks.check(usage);}));
+  result.emplace_back(make_benchmark("peak_scope",                    []{peak_scope scope; return scope.finish();}));
+  result.emplace_back(make_benchmark("peak_scope_high_water_mark",    []{peak_scope scope{nullptr, peak_method::high_water_mark}; return scope.finish();}));
+  result.emplace_back(make_benchmark("stats_publisher_publish",       []{publisher.publish(current); return publisher.is_open();}, false));
+  result.emplace_back(make_benchmark("stats_reader_read",             []{
+    published_stats stats;
+    return reader.read(stats);
+  }));
+  result.emplace_back(make_benchmark("trend_analyser_check",          []{return trends.check();}));
+  result.emplace_back(make_benchmark("trend_analyser_check_supplied", []{return trends.check(std::chrono::steady_clock::now(), usage, usage, 0);}));
+  result.emplace_back(make_benchmark("arena_allocate",                []{
+    if(frame.get_used_bytes() >= 1024 * 1024) {
+      frame.reset();
+    }
+    return frame.allocate(64, 8);
+  }, false));
+  result.emplace_back(make_benchmark("pool_create_destroy",           []{
+    uint64_t *const value{values.create(0)};
+    values.destroy(value);
+    return value;
+  }, false));
+  result.emplace_back(make_benchmark("new_delete",                    []{
+    uint64_t *volatile value{new uint64_t{0}};
+    delete value;
+    return 0;
+  }));
+  return result;
+}
+
+std::map<std::pair<std::string, unsigned int>, result> read_baseline(std::string const &filename) {
+  /// Load results previously written with --format csv
+  std::map<std::pair<std::string, unsigned int>, result> baseline;
+  std::ifstream file{filename};
+  std::string line;
+  std::getline(file, line);                                                     // header
+  while(std::getline(file, line)) {
+    std::istringstream ss{line};
+    result entry;
+    std::string field;
+    if(!std::getline(ss, entry.name, ',')) {
+      continue;
+    }
+    std::getline(ss, field, ',');
+    entry.threads = static_cast<unsigned int>(std::strtoul(field.c_str(), nullptr, 10));
+    std::getline(ss, field, ',');
+    entry.ns_per_call = std::strtod(field.c_str(), nullptr);
+    std::getline(ss, field, ',');
+    entry.allocations_per_call = std::strtod(field.c_str(), nullptr);
+    baseline[{entry.name, entry.threads}] = entry;
+  }
+  return baseline;
+}
+
+void write_results(std::ostream &out, std::vector<result> const &results, std::string const &format) {
+  if(format == "csv") {
+    out << "name,threads,ns_per_call,allocations_per_call,iterations\n";
+    for(auto const &entry : results) {
+      out << entry.name << ',' << entry.threads << ',' << entry.ns_per_call << ',' << entry.allocations_per_call << ',' << entry.iterations << '\n';
+    }
+  } else if(format == "json") {
+    out << "[\n";
+    for(size_t i{0}; i != results.size(); ++i) {
+      auto const &entry{results[i]};
+      out << "  {\"name\": \"" << entry.name << "\", \"threads\": " << entry.threads <<
+             ", \"ns_per_call\": " << entry.ns_per_call << ", \"allocations_per_call\": " << entry.allocations_per_call <<
+             ", \"iterations\": " << entry.iterations << "}" << (i + 1 != results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+  } else {
+    for(auto const &entry : results) {
+      out << std::left << std::setw(40) << entry.name << std::right << std::setw(4) << entry.threads << " threads " <<
+             std::setw(14) << std::fixed << std::setprecision(1) << entry.ns_per_call << " ns/call " <<
+             std::setw(10) << std::setprecision(3) << entry.allocations_per_call << " allocations/call\n";
+    }
+  }
+}
+
+bool parse_options(int argc, char **argv, options &parsed) {
+  for(int i{1}; i < argc; ++i) {
+    std::string const argument{argv[i]};
+    auto const value{[&]() -> std::string {
+      return i + 1 < argc ? argv[++i] : std::string{};
+    }};
+    if(argument == "--threads") {
+      parsed.threads = static_cast<unsigned int>(std::strtoul(value().c_str(), nullptr, 10));
+    } else if(argument == "--min-time") {
+      parsed.min_time = std::chrono::milliseconds{std::strtoll(value().c_str(), nullptr, 10)};
+    } else if(argument == "--filter") {
+      parsed.filter = value();
+    } else if(argument == "--format") {
+      parsed.format = value();
+    } else if(argument == "--output") {
+      parsed.output = value();
+    } else if(argument == "--baseline") {
+      parsed.baseline = value();
+    } else if(argument == "--tolerance") {
+      parsed.tolerance = std::strtod(value().c_str(), nullptr);
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--threads N] [--min-time MS] [--filter TEXT] [--format text|csv|json]"
+                                           " [--output FILE] [--baseline FILE] [--tolerance PERCENT]" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+  options parsed;
+  if(!parse_options(argc, argv, parsed)) {
+    return 2;
+  }
+  if(!alloc_hooks_installed()) {
+    std::cerr << "memorystorm_bench: allocation hooks are not linked in, allocations/call will read zero" << std::endl;
+  }
+
+  std::vector<result> results;
+  for(auto const &bench : make_benchmarks()) {
+    if(!parsed.filter.empty() && bench.name.find(parsed.filter) == std::string::npos) {
+      continue;
+    }
+    uint64_t const iterations{calibrate(bench, parsed.min_time)};
+    results.emplace_back(measure_single(bench, iterations));
+    if(bench.thread_safe && parsed.threads > 1) {
+      results.emplace_back(measure_contended(bench, iterations, parsed.threads));
+    }
+  }
+
+  if(parsed.output.empty()) {
+    write_results(std::cout, results, parsed.format);
+  } else {
+    std::ofstream file{parsed.output};
+    write_results(file, results, parsed.format);
+    if(!file) {
+      std::cerr << "memorystorm_bench: failed to write " << parsed.output << std::endl;
+      return 2;
+    }
+  }
+
+  if(parsed.baseline.empty()) {
+    return 0;
+  }
+  auto const baseline{read_baseline(parsed.baseline)};
+  if(baseline.empty()) {
+    std::cerr << "memorystorm_bench: no results in baseline " << parsed.baseline << std::endl;
+    return 2;
+  }
+  unsigned int regressions{0};
+  for(auto const &entry : results) {
+    auto const it{baseline.find({entry.name, entry.threads})};
+    if(it == baseline.end()) {
+      continue;
+    }
+    auto const &expected{it->second};
+    if(entry.ns_per_call > expected.ns_per_call * (1.0 + parsed.tolerance / 100.0)) {
+      std::cerr << "REGRESSION " << entry.name << " (" << entry.threads << " threads): " <<
+                   entry.ns_per_call << " ns/call, baseline " << expected.ns_per_call << std::endl;
+      ++regressions;
+    }
+    if(entry.allocations_per_call > expected.allocations_per_call + 0.01) {     // allocation counts are deterministic, so allow no slack beyond rounding
+      std::cerr << "REGRESSION " << entry.name << " (" << entry.threads << " threads): " <<
+                   entry.allocations_per_call << " allocations/call, baseline " << expected.allocations_per_call << std::endl;
+      ++regressions;
+    }
+  }
+  return regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "heap_profiler.h"
+#include "memorystorm.h"
+#include "peak.h"
+#include "scope_tag.h"
+
+using namespace memorystorm;
+
+// ---------------------------------------------------------------------------
+// Allocation hooks – this executable links alloc_hooks.cpp
+// ---------------------------------------------------------------------------
+
+TEST_CASE("alloc_hooks_installed: true when alloc_hooks.cpp is linked", "[alloc]") {
+  CHECK(alloc_hooks_installed());
+}
+
+TEST_CASE("get_alloc_stats: counts a single allocation and its release", "[alloc]") {
+  auto const before{get_alloc_stats()};
+  uint64_t *volatile value{new uint64_t[1'000]};                               // volatile so the optimiser can't elide the allocation
+  auto const during{get_alloc_stats()};
+  delete[] value;
+  auto const after{get_alloc_stats()};
+  CHECK(during.allocations - before.allocations == 1);
+  CHECK(during.allocated_bytes - before.allocated_bytes >= 1'000 * sizeof(uint64_t));
+  CHECK(after.deallocations - during.deallocations == 1);
+  CHECK(after.freed_bytes - during.freed_bytes == during.allocated_bytes - before.allocated_bytes);
+}
+
+TEST_CASE("get_alloc_stats: counts aligned and nothrow forms", "[alloc]") {
+  struct alignas(256) overaligned {
+    char data[256];
+  };
+  auto const before{get_alloc_stats()};
+  overaligned *volatile aligned{new overaligned};
+  CHECK(reinterpret_cast<uintptr_t>(aligned) % 256 == 0);
+  int *volatile nothrow{new(std::nothrow) int{42}};
+  REQUIRE(nothrow != nullptr);
+  delete aligned;
+  delete nothrow;
+  auto const after{get_alloc_stats()};
+  CHECK(after.allocations - before.allocations == 2);
+  CHECK(after.deallocations - before.deallocations == 2);
+  CHECK(after.freed_bytes - before.freed_bytes == after.allocated_bytes - before.allocated_bytes);
+}
+
+TEST_CASE("get_alloc_stats: counts survive thread exit", "[alloc][threads]") {
+  auto const before{get_alloc_stats()};
+  std::vector<std::thread> threads;
+  for(unsigned int i{0}; i != 4; ++i) {
+    threads.emplace_back([]{
+      std::vector<std::unique_ptr<int>> values;
+      for(unsigned int j{0}; j != 1'000; ++j) {
+        values.emplace_back(std::make_unique<int>(static_cast<int>(j)));
+      }
+    });
+  }
+  for(auto &thread : threads) {
+    thread.join();
+  }
+  auto const after{get_alloc_stats()};
+  CHECK(after.allocations - before.allocations >= 4'000);
+  CHECK(after.deallocations - before.deallocations >= 4'000);
+}
+
+TEST_CASE("get_stats: includes heap totals when hooks are installed", "[alloc][stats]") {
+  CHECK_THAT(get_stats(), Catch::Matchers::ContainsSubstring("Heap live"));
+}
+
+// ---------------------------------------------------------------------------
+// Heap profiler – sampling through the allocation hooks
+// ---------------------------------------------------------------------------
+
+TEST_CASE("heap profiler: samples live allocations and forgets freed ones", "[alloc][heap_profiler]") {
+  start_heap_profiler(4'096);
+  CHECK(heap_profiler_running());
+  std::vector<std::unique_ptr<char[]>> blocks;
+  for(unsigned int i{0}; i != 1'000; ++i) {
+    blocks.emplace_back(new char[4'096]);
+  }
+  auto const sampled{get_heap_profile_sample_count()};
+  CHECK(sampled > 100);                                                         // expect around one sample per block
+  CHECK(sampled < 2'000);
+  blocks.clear();
+  blocks.shrink_to_fit();
+  CHECK(get_heap_profile_sample_count() < sampled / 10);
+  stop_heap_profiler();
+  CHECK_FALSE(heap_profiler_running());
+  CHECK(get_heap_profile_sample_count() == 0);
+}
+
+TEST_CASE("heap profiler: writes a gperftools heap_v2 profile", "[alloc][heap_profiler]") {
+  start_heap_profiler(1'024);
+  std::vector<std::unique_ptr<char[]>> blocks;
+  for(unsigned int i{0}; i != 1'000; ++i) {
+    blocks.emplace_back(new char[1'024]);
+  }
+  auto const profile{get_heap_profile()};
+  stop_heap_profiler();
+  CHECK_THAT(profile, Catch::Matchers::StartsWith("heap profile: "));
+  CHECK_THAT(profile, Catch::Matchers::ContainsSubstring("@ heap_v2/1024"));
+  CHECK_THAT(profile, Catch::Matchers::ContainsSubstring("] @ 0x"));
+#if defined(__linux__)
+  CHECK_THAT(profile, Catch::Matchers::ContainsSubstring("MAPPED_LIBRARIES:"));
+#endif
+}
+
+TEST_CASE("heap profiler: records nothing while stopped", "[alloc][heap_profiler]") {
+  std::vector<std::unique_ptr<char[]>> blocks;
+  for(unsigned int i{0}; i != 100; ++i) {
+    blocks.emplace_back(new char[65'536]);
+  }
+  CHECK(get_heap_profile_sample_count() == 0);
+}
+
+// ---------------------------------------------------------------------------
+// Scope tags – this executable builds alloc_hooks.cpp with MEMORYSTORM_ALLOC_TAGS
+// ---------------------------------------------------------------------------
+
+namespace {
+
+tag_stats find_tag(uint32_t tag) {
+  for(auto const &stats : get_tag_stats()) {
+    if(stats.tag == tag) {
+      return stats;
+    }
+  }
+  return {};
+}
+
+}
+
+TEST_CASE("register_tag: names map to stable ids", "[alloc][scope_tag]") {
+  uint32_t const first{register_tag("test_stable")};
+  CHECK(first != untagged);
+  CHECK(register_tag("test_stable") == first);
+  CHECK(register_tag("test_other") != first);
+  CHECK(get_tag_name(first) == "test_stable");
+  CHECK(get_tag_name(untagged) == "untagged");
+}
+
+TEST_CASE("scope_tag: nests and restores the previous tag", "[alloc][scope_tag]") {
+  uint32_t const outer_tag{register_tag("test_outer")};
+  uint32_t const inner_tag{register_tag("test_inner")};
+  CHECK(get_current_tag() == untagged);
+  {
+    scope_tag outer{outer_tag};
+    CHECK(get_current_tag() == outer_tag);
+    {
+      scope_tag inner{inner_tag};
+      CHECK(get_current_tag() == inner_tag);
+    }
+    CHECK(get_current_tag() == outer_tag);
+  }
+  CHECK(get_current_tag() == untagged);
+}
+
+TEST_CASE("scope_tag: charges allocations and frees to the allocating tag", "[alloc][scope_tag]") {
+  uint32_t const tag{register_tag("test_charge")};
+  auto const before{find_tag(tag)};
+  char *volatile block{nullptr};
+  {
+    scope_tag scope{tag};
+    block = new char[100'000];
+  }
+  auto const during{find_tag(tag)};
+  CHECK(during.allocations - before.allocations == 1);
+  CHECK(during.live_bytes - before.live_bytes >= 100'000);
+  CHECK(during.peak_bytes >= during.live_bytes);
+  delete[] block;                                                               // freed outside the scope, still charged to the tag
+  auto const after{find_tag(tag)};
+  CHECK(after.live_bytes == before.live_bytes);
+  CHECK(after.peak_bytes >= 100'000);
+}
+
+TEST_CASE("scope_tag: the peak covers blocks freed before stats are read", "[alloc][scope_tag]") {
+  uint32_t const tag{register_tag("test_transient_peak")};
+  {
+    scope_tag scope{tag};
+    char *volatile block{new char[200'000]};
+    delete[] block;
+  }
+  auto const stats{find_tag(tag)};
+  CHECK(stats.live_bytes == 0);
+  CHECK(stats.peak_bytes >= 200'000);
+}
+
+TEST_CASE("scope_tag: tags are per thread and summed across threads", "[alloc][scope_tag]") {
+  uint32_t const tag{register_tag("test_threads")};
+  auto const before{find_tag(tag)};
+  std::vector<std::thread> threads;
+  for(unsigned int i{0}; i != 4; ++i) {
+    threads.emplace_back([tag]{
+      scope_tag scope{tag};
+      for(unsigned int j{0}; j != 100; ++j) {
+        int *volatile value{new int{0}};
+        delete value;
+      }
+    });
+  }
+  {
+    int *volatile untagged_value{new int{0}};                                   // this thread isn't in the scope
+    delete untagged_value;
+  }
+  for(auto &thread : threads) {
+    thread.join();
+  }
+  auto const after{find_tag(tag)};
+  CHECK(after.allocations - before.allocations == 400);
+  CHECK(after.live_allocations == before.live_allocations);
+}
+
+TEST_CASE("scope_tag: aligned allocations keep their alignment", "[alloc][scope_tag]") {
+  struct alignas(128) overaligned {
+    char data[128];
+  };
+  uint32_t const tag{register_tag("test_aligned")};
+  scope_tag scope{tag};
+  overaligned *volatile aligned{new overaligned};
+  CHECK(reinterpret_cast<uintptr_t>(aligned) % 128 == 0);
+  CHECK(find_tag(tag).live_allocations >= 1);
+  delete aligned;
+}
+
+TEST_CASE("get_tag_report: lists registered tags", "[alloc][scope_tag]") {
+  register_tag("test_report");
+  auto const report{get_tag_report()};
+  CHECK_THAT(report, Catch::Matchers::ContainsSubstring("MemoryStorm: Tag untagged live "));
+  CHECK_THAT(report, Catch::Matchers::ContainsSubstring("MemoryStorm: Tag test_report live "));
+}
+
+TEST_CASE("peak_scope: heap peaks are exact with the hooks", "[alloc][peak]") {
+  REQUIRE(get_default_peak_method() == peak_method::alloc_hooks);
+  peak_scope outer;
+  char *volatile first{new char[1'000'000]};
+  delete[] first;
+  uint64_t inner_increase{0};
+  {
+    peak_scope inner;
+    char *volatile second{new char[100'000]};
+    delete[] second;
+    inner_increase = inner.finish().increase();
+  }
+  CHECK(inner_increase >= 100'000);
+  CHECK(inner_increase < 1'000'000);
+  auto const usage{outer.finish()};
+  CHECK(usage.method == peak_method::alloc_hooks);
+  CHECK(usage.increase() >= 1'000'000);
+  CHECK(usage.increase() < 1'100'000);
+}
@@ -0,0 +1,186 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "pool.h"
+
+using namespace memorystorm;
+
+namespace {
+
+allocator_stats find_allocator(std::string const &name) {
+  for(auto const &stats : get_allocator_stats()) {
+    if(stats.name == name) {
+      return stats;
+    }
+  }
+  return {};
+}
+
+bool is_registered(std::string const &name) {
+  for(auto const &stats : get_allocator_stats()) {
+    if(stats.name == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}
+
+// ---------------------------------------------------------------------------
+// arena
+// ---------------------------------------------------------------------------
+
+TEST_CASE("arena: allocations are aligned and don't overlap", "[arena]") {
+  arena frame{"test_arena_align"};
+  auto *const a{static_cast<char*>(frame.allocate(3, 1))};
+  auto *const b{static_cast<char*>(frame.allocate(8, 8))};
+  auto *const c{static_cast<char*>(frame.allocate(64, 64))};
+  CHECK(reinterpret_cast<uintptr_t>(b) % 8 == 0);
+  CHECK(reinterpret_cast<uintptr_t>(c) % 64 == 0);
+  CHECK(b >= a + 3);
+  CHECK(c >= b + 8);
+  CHECK(frame.get_used_bytes() == 3 + 8 + 64);
+}
+
+TEST_CASE("arena: reset reuses blocks without returning them", "[arena]") {
+  arena frame{"test_arena_reset", unlimited, 4'096};
+  for(unsigned int i{0}; i != 100; ++i) {
+    CHECK(frame.allocate(100, 8) != nullptr);
+  }
+  uint64_t const reserved{frame.get_reserved_bytes()};
+  CHECK(reserved >= 100 * 100);
+  frame.reset();
+  CHECK(frame.get_used_bytes() == 0);
+  for(unsigned int i{0}; i != 100; ++i) {
+    CHECK(frame.allocate(100, 8) != nullptr);
+  }
+  CHECK(frame.get_reserved_bytes() == reserved);
+  frame.release();
+  CHECK(frame.get_reserved_bytes() == 0);
+}
+
+TEST_CASE("arena: serves requests larger than the block size", "[arena]") {
+  arena frame{"test_arena_large", unlimited, 1'024};
+  void *const large{frame.allocate(100'000, 16)};
+  CHECK(large != nullptr);
+  CHECK(frame.get_reserved_bytes() >= 100'000);
+}
+
+TEST_CASE("arena: enforces its budget", "[arena]") {
+  arena frame{"test_arena_budget", 16'384, 4'096};
+  CHECK_THROWS_AS(frame.allocate(32'768, 8), std::bad_alloc);
+  CHECK_NOTHROW(frame.allocate(1'000, 8));
+  CHECK(frame.get_reserved_bytes() <= 16'384);
+  auto const stats{find_allocator("test_arena_budget")};
+  CHECK(stats.budget == 16'384);
+  CHECK(stats.failed_allocations == 1);
+}
+
+TEST_CASE("arena: refuses sizes that would overflow", "[arena]") {
+  arena frame{"test_arena_overflow"};
+  CHECK_NOTHROW(frame.allocate(64, 8));                                         // a current block, so the fast path is tried first
+  size_t volatile huge{SIZE_MAX - 8};                                           // volatile, or the compiler warns about the constant size
+  CHECK_THROWS_AS(frame.allocate(huge, 8), std::bad_alloc);
+  huge = SIZE_MAX;
+  CHECK_THROWS_AS(frame.allocate(huge, 64), std::bad_alloc);
+  CHECK(frame.get_used_bytes() == 64);
+}
+
+TEST_CASE("arena: works with pmr containers", "[arena]") {
+  arena frame{"test_arena_pmr"};
+  std::pmr::vector<int> values{&frame};
+  for(int i{0}; i != 1'000; ++i) {
+    values.emplace_back(i);
+  }
+  CHECK(values[999] == 999);
+  CHECK(frame.get_used_bytes() >= 1'000 * sizeof(int));
+}
+
+// ---------------------------------------------------------------------------
+// pool
+// ---------------------------------------------------------------------------
+
+TEST_CASE("pool: create and destroy reuse chunks", "[pool]") {
+  struct particle {
+    double position[3];
+    double velocity[3];
+  };
+  pool<particle> particles{"test_pool_reuse", unlimited, 16};
+  particle *const first{particles.create()};
+  CHECK(particles.get_used_bytes() >= sizeof(particle));
+  particles.destroy(first);
+  CHECK(particles.get_used_bytes() == 0);
+  particle *const second{particles.create()};
+  CHECK(second == first);                                                       // last freed, first reused
+  particles.destroy(second);
+}
+
+TEST_CASE("pool: grows by whole blocks", "[pool]") {
+  pool<uint64_t> values{"test_pool_grow", unlimited, 8};
+  std::vector<uint64_t*> created;
+  for(uint64_t i{0}; i != 20; ++i) {
+    created.emplace_back(values.create(i));
+  }
+  for(uint64_t i{0}; i != 20; ++i) {
+    CHECK(*created[i] == i);
+  }
+  uint64_t const reserved{values.get_reserved_bytes()};
+  CHECK(reserved >= 20 * sizeof(uint64_t));
+  for(auto *value : created) {
+    values.destroy(value);
+  }
+  CHECK(values.get_reserved_bytes() == reserved);                               // chunks go back on the free list, not upstream
+}
+
+TEST_CASE("pool: enforces its budget", "[pool]") {
+  pool<uint64_t> values{"test_pool_budget", 256, 16};
+  std::vector<uint64_t*> created;
+  CHECK_THROWS_AS([&]{
+    for(unsigned int i{0}; i != 1'000; ++i) {
+      created.emplace_back(values.create());
+    }
+  }(), std::bad_alloc);
+  CHECK(values.get_reserved_bytes() <= 256);
+  CHECK(find_allocator("test_pool_budget").failed_allocations == 1);
+  for(auto *value : created) {
+    values.destroy(value);
+  }
+}
+
+TEST_CASE("pool: passes oversized requests upstream", "[pool]") {
+  pool<uint32_t> values{"test_pool_oversized"};
+  void *const large{values.allocate(1'024, 8)};
+  CHECK(values.get_used_bytes() == 1'024);
+  values.deallocate(large, 1'024, 8);
+  CHECK(values.get_used_bytes() == 0);
+  CHECK(values.get_reserved_bytes() == 0);
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------
+
+TEST_CASE("get_allocator_stats: tracks live resources only", "[arena][pool]") {
+  {
+    arena frame{"test_registry_arena"};
+    pool<int> ints{"test_registry_pool"};
+    CHECK(is_registered("test_registry_arena"));
+    CHECK(is_registered("test_registry_pool"));
+  }
+  CHECK_FALSE(is_registered("test_registry_arena"));
+  CHECK_FALSE(is_registered("test_registry_pool"));
+}
+
+TEST_CASE("get_stats: shows arena usage", "[arena]") {
+  arena frame{"test_stats_arena", 1'048'576};
+  CHECK(frame.allocate(1'000, 8) != nullptr);
+  CHECK(find_allocator("test_stats_arena").peak_used_bytes == 1'000);
+  CHECK_THAT(get_stats(), Catch::Matchers::ContainsSubstring("MemoryStorm: Allocator test_stats_arena using "));
+  CHECK_THAT(get_stats(), Catch::Matchers::ContainsSubstring("budget "));
+}
@@ -0,0 +1,142 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+#include "cgroup.h"
+
+#if defined(__linux__)
+  #include <cstdlib>
+  #include <fstream>
+  #include <sys/stat.h>
+#endif
+
+using namespace memorystorm;
+
+// ---------------------------------------------------------------------------
+// cgroup detection – fixture text for /proc/self/cgroup and mountinfo
+// ---------------------------------------------------------------------------
+
+#if defined(__linux__)
+namespace {
+
+char const *const v2_mountinfo{
+  "22 1 259:2 / / rw,relatime shared:1 - ext4 /dev/root rw\n"
+  "30 25 0:26 / /sys/fs/cgroup rw,nosuid,nodev,noexec,relatime shared:4 - cgroup2 cgroup2 rw,nsdelegate,memory_recursiveprot\n"
+};
+
+char const *const hybrid_mountinfo{
+  "22 1 259:2 / / rw,relatime shared:1 - ext4 /dev/root rw\n"
+  "31 25 0:27 / /sys/fs/cgroup/unified rw,nosuid shared:5 - cgroup2 cgroup2 rw,nsdelegate\n"
+  "35 25 0:31 / /sys/fs/cgroup/cpu,cpuacct rw,nosuid shared:9 - cgroup cgroup rw,cpu,cpuacct\n"
+  "36 25 0:32 / /sys/fs/cgroup/memory rw,nosuid shared:10 - cgroup cgroup rw,memory\n"
+};
+
+std::string with_memory(std::string const&) {
+  return "cpuset cpu io memory pids";
+}
+
+std::string without_memory(std::string const&) {
+  return "";
+}
+
+struct temporary_directory {
+  /// A scratch directory tree, removed with its files afterwards
+  std::string path;
+
+  temporary_directory() {
+    char pattern[]{"/tmp/memorystorm_cgroup_XXXXXX"};
+    path = mkdtemp(pattern);
+  }
+  ~temporary_directory() {
+    std::string const command{"rm -rf " + path};
+    int const result{std::system(command.c_str())};
+    (void)result;
+  }
+
+  void write(std::string const &name, std::string const &contents) const {
+    std::ofstream{path + "/" + name} << contents << "\n";
+  }
+  void make(std::string const &name) const {
+    mkdir((path + "/" + name).c_str(), 0700);
+  }
+};
+
+}
+
+TEST_CASE("find_cgroup: v2 hierarchy", "[cgroup]") {
+  auto const location{detail::find_cgroup("0::/user.slice/app.service\n", v2_mountinfo, with_memory)};
+  CHECK(location.version == cgroup_version::v2);
+  CHECK(location.path == "/sys/fs/cgroup/user.slice/app.service");
+  CHECK(location.mount_point == "/sys/fs/cgroup");
+}
+
+TEST_CASE("find_cgroup: falls back to v1 when the memory controller isn't on v2", "[cgroup]") {
+  char const *const cgroup_file{
+    "5:cpu,cpuacct:/docker/abc123\n"
+    "4:memory:/docker/abc123\n"
+    "0::/docker/abc123\n"
+  };
+  auto const location{detail::find_cgroup(cgroup_file, hybrid_mountinfo, without_memory)};
+  CHECK(location.version == cgroup_version::v1);
+  CHECK(location.path == "/sys/fs/cgroup/memory/docker/abc123");
+  CHECK(location.mount_point == "/sys/fs/cgroup/memory");
+}
+
+TEST_CASE("find_cgroup: a container sees its own cgroup as the mount root", "[cgroup]") {
+  char const *const container_mountinfo{
+    "1184 1183 0:26 /kubepods/pod1/ctr /sys/fs/cgroup ro,nosuid - cgroup2 cgroup2 rw,nsdelegate\n"
+  };
+  auto const root{detail::find_cgroup("0::/kubepods/pod1/ctr\n", container_mountinfo, with_memory)};
+  CHECK(root.version == cgroup_version::v2);
+  CHECK(root.path == "/sys/fs/cgroup");
+  auto const nested{detail::find_cgroup("0::/kubepods/pod1/ctr/worker\n", container_mountinfo, with_memory)};
+  CHECK(nested.path == "/sys/fs/cgroup/worker");
+}
+
+TEST_CASE("find_cgroup: none without a memory controller", "[cgroup]") {
+  CHECK(detail::find_cgroup("0::/\n", v2_mountinfo, without_memory).version == cgroup_version::none);
+  CHECK(detail::find_cgroup("", "", with_memory).path.empty());
+}
+
+TEST_CASE("cgroup_directories: limits are the minimum over ancestors, values are the cgroup's own", "[cgroup]") {
+  temporary_directory root;
+  root.make("parent");
+  root.make("parent/child");
+  root.write("memory.max", "5000");
+  root.write("parent/memory.max", "1000");
+  root.write("parent/memory.current", "900");
+  root.write("parent/child/memory.max", "max");
+  root.write("parent/child/memory.current", "42");
+  detail::cgroup_location location{cgroup_version::v2, root.path + "/parent/child", root.path};
+  {
+    detail::cgroup_directories const directories{location};
+    CHECK(directories.get_own() >= 0);
+    CHECK(directories.read_limit("memory.max") == 1000);
+    CHECK(directories.read_limit("memory.high") == unlimited);
+    CHECK(directories.read_value("memory.current") == 42);
+  }
+  location.path = root.path + "/parent/missing";                                // unopenable: never report the parent's usage instead
+  detail::cgroup_directories const directories{location};
+  CHECK(directories.get_own() < 0);
+  CHECK(directories.read_value("memory.current") == 0);
+  CHECK(directories.read_limit("memory.max") == 1000);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// cgroup limits – contract checks that hold both inside and outside containers
+// ---------------------------------------------------------------------------
+
+TEST_CASE("get_cgroup_path: is set exactly when a cgroup was detected", "[cgroup]") {
+  CHECK(get_cgroup_path().empty() == (get_cgroup_version() == cgroup_version::none));
+}
+
+TEST_CASE("get_effective_physical_total: bounded by host memory and cgroup limit", "[cgroup][physical]") {
+  auto const effective{get_effective_physical_total()};
+  CHECK(effective > 0);
+  CHECK(effective <= get_physical_total());
+  CHECK(effective <= get_cgroup_memory_max());
+}
+
+TEST_CASE("get_effective_physical_available: bounded by the effective total", "[cgroup][physical]") {
+  CHECK(get_effective_physical_available() <= get_effective_physical_total());
+}
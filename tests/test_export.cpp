@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+#include <iterator>
+#include <string>
+
+#include "export.h"
+#include "memorystorm.h"
+
+using namespace memorystorm;
+
+namespace {
+
+snapshot make_test_snapshot() {
+  snapshot value;
+  value.stack_available    = 1;
+  value.physical_total     = 2;
+  value.physical_available = 3;
+  value.physical_usage     = 4;
+  value.virtual_total      = 5;
+  value.virtual_available  = 6;
+  value.virtual_usage      = UINT64_MAX;
+  return value;
+}
+
+}
+
+// ---------------------------------------------------------------------------
+// human_readable_to – allocation-free formatting
+// ---------------------------------------------------------------------------
+
+TEST_CASE("human_readable_to: matches human_readable", "[export][human_readable]") {
+  for(uint64_t const amount : {uint64_t{0}, uint64_t{1'023}, uint64_t{1'536}, uint64_t{9'728}, uint64_t{10'240},
+                               uint64_t{5'767'168}, uint64_t{3} << 40, uint64_t{15} << 50, UINT64_MAX}) {
+    char buffer[human_readable_max_length];
+    size_t const length{human_readable_to(amount, buffer, sizeof(buffer))};
+    REQUIRE(length != 0);
+    CHECK(std::string(buffer, length) == human_readable(amount));
+  }
+  char buffer[human_readable_max_length];
+  CHECK(std::string(buffer, human_readable_to(1'536, buffer, sizeof(buffer))) == "1.5KB");
+  CHECK(std::string(buffer, human_readable_to(1'280, buffer, sizeof(buffer))) == "1.2KB");    // 1.25 rounds to even
+  CHECK(std::string(buffer, human_readable_to(1'331, buffer, sizeof(buffer))) == "1.3KB");
+  CHECK(std::string(buffer, human_readable_to(10'239, buffer, sizeof(buffer))) == "10KB");
+  CHECK(std::string(buffer, human_readable_to(uint64_t{15} << 49, buffer, sizeof(buffer))) == "7.5PB");
+  CHECK(std::string(buffer, human_readable_to(UINT64_MAX, buffer, sizeof(buffer))) == "16383PB");
+}
+
+TEST_CASE("human_readable_to: returns 0 when the buffer is too small", "[export][human_readable]") {
+  char buffer[4];
+  CHECK(human_readable_to(512, buffer, 4) == 4);                                // "512B" exactly fits
+  CHECK(human_readable_to(1'023, buffer, 4) == 0);
+  CHECK(human_readable_to(10'240, buffer, 3) == 0);                             // number fits, unit doesn't
+  CHECK(human_readable_to(0, buffer, 0) == 0);
+}
+
+// ---------------------------------------------------------------------------
+// Structured writers
+// ---------------------------------------------------------------------------
+
+TEST_CASE("write_json: every field as a JSON member", "[export]") {
+  char buffer[512];
+  size_t const length{write_json(buffer, sizeof(buffer), make_test_snapshot())};
+  CHECK(std::string(buffer, length) ==
+        "{\"stack_available\":1,\"physical_total\":2,\"physical_available\":3,\"physical_usage\":4,"
+        "\"virtual_total\":5,\"virtual_available\":6,\"virtual_usage\":18446744073709551615}");
+}
+
+TEST_CASE("write_prometheus: gauges with help and type lines", "[export]") {
+  char buffer[2048];
+  size_t const length{write_prometheus(buffer, sizeof(buffer), make_test_snapshot(), "app_")};
+  std::string const text(buffer, length);
+  CHECK_THAT(text, Catch::Matchers::StartsWith("# HELP app_stack_available_bytes "));
+  CHECK_THAT(text, Catch::Matchers::ContainsSubstring("# TYPE app_physical_usage_bytes gauge\napp_physical_usage_bytes 4\n"));
+  CHECK_THAT(text, Catch::Matchers::EndsWith("app_virtual_usage_bytes 18446744073709551615\n"));
+}
+
+TEST_CASE("write_csv: header and row line up", "[export]") {
+  char header[256];
+  char row[256];
+  size_t const header_length{write_csv_header(header, sizeof(header))};
+  size_t const row_length{write_csv(row, sizeof(row), make_test_snapshot())};
+  CHECK(std::string(header, header_length) == "stack_available,physical_total,physical_available,physical_usage,virtual_total,virtual_available,virtual_usage\n");
+  CHECK(std::string(row, row_length) == "1,2,3,4,5,6,18446744073709551615\n");
+}
+
+TEST_CASE("write_json: returns 0 rather than truncating", "[export]") {
+  char buffer[32];
+  CHECK(write_json(buffer, sizeof(buffer), make_test_snapshot()) == 0);
+  CHECK(write_csv(buffer, 0, make_test_snapshot()) == 0);
+}
+
+TEST_CASE("write_json: works with any output iterator", "[export]") {
+  std::string text;
+  write_json(std::back_inserter(text), make_test_snapshot());
+  char buffer[512];
+  CHECK(text == std::string(buffer, write_json(buffer, sizeof(buffer), make_test_snapshot())));
+}
@@ -0,0 +1,110 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "heap.h"
+#include "memorystorm.h"
+
+using namespace memorystorm;
+using namespace std::chrono_literals;
+
+#if defined(__GLIBC__)
+namespace {
+
+struct fragmented_heap {
+  /// Many small blocks, of which only every 64th is kept, leaving page-sized free runs that malloc holds on to
+  std::vector<void*> kept;
+
+  explicit fragmented_heap(size_t count) {
+    std::vector<void*> blocks(count);
+    for(auto &block : blocks) {
+      block = std::malloc(1000);
+      std::memset(block, 1, 1000);
+    }
+    for(size_t i{0}; i != count; ++i) {
+      if(i % 64 == 0) {
+        kept.emplace_back(blocks[i]);
+      } else {
+        std::free(blocks[i]);
+      }
+    }
+  }
+  ~fragmented_heap() {
+    for(void *block : kept) {
+      std::free(block);
+    }
+  }
+};
+
+}
+
+TEST_CASE("get_heap_stats: freed blocks show up as free heap", "[heap]") {
+  auto const before{get_heap_stats()};
+  REQUIRE(before.valid);
+  CHECK(before.arenas >= 1);
+  CHECK(before.in_use_bytes > 0);
+  CHECK(before.rss > 0);
+  fragmented_heap heap{100'000};
+  auto const after{get_heap_stats()};
+  CHECK(after.free_bytes >= before.free_bytes + 64 * 1024 * 1024);
+  CHECK(after.fragmentation_ratio() > 0.0);
+  CHECK(after.fragmentation_ratio() <= 1.0);
+  CHECK(after.free_fraction() > 0.5);
+}
+
+TEST_CASE("release_free_heap: returns fragmented free memory", "[heap]") {
+  fragmented_heap heap{100'000};
+  CHECK(release_free_heap() >= 32 * 1024 * 1024);
+}
+
+TEST_CASE("heap_trimmer: trims past the threshold and is rate limited", "[heap]") {
+  heap_trim_policy policy;
+  policy.fragmentation_threshold = 0.01;
+  policy.min_free_bytes = 16 * 1024 * 1024;
+  policy.pressure_threshold = 0.0;
+  policy.min_interval = 1h;
+  heap_trimmer trimmer{policy};
+  CHECK_FALSE(trimmer.should_trim(heap_stats{}));
+  {
+    fragmented_heap heap{100'000};
+    REQUIRE(trimmer.should_trim(get_heap_stats()));
+    auto const result{trimmer.check()};
+    CHECK(result.trimmed);
+    CHECK(result.rss_after < result.rss_before);
+  }
+  fragmented_heap heap{100'000};
+  CHECK_FALSE(trimmer.check().trimmed);                                         // within min_interval of the last trim
+  CHECK(trimmer.get_trim_count() == 1);
+  CHECK(trimmer.get_released_bytes() > 0);
+}
+
+TEST_CASE("heap_trimmer: concurrent checks trim once", "[heap]") {
+  heap_trim_policy policy;
+  policy.fragmentation_threshold = 0.01;
+  policy.min_free_bytes = 16 * 1024 * 1024;
+  policy.pressure_threshold = 0.0;
+  policy.min_interval = 1h;
+  heap_trimmer trimmer{policy};
+  fragmented_heap heap{100'000};
+  REQUIRE(trimmer.should_trim(get_heap_stats()));
+  std::vector<std::thread> threads;
+  for(unsigned int i{0}; i != 8; ++i) {
+    threads.emplace_back([&trimmer]{ trimmer.check(); });
+  }
+  for(auto &thread : threads) {
+    thread.join();
+  }
+  CHECK(trimmer.get_trim_count() == 1);
+}
+#endif
+
+TEST_CASE("heap_trimmer: starts and stops a background thread", "[heap]") {
+  heap_trimmer trimmer;
+  trimmer.start(10ms);
+  CHECK(trimmer.running());
+  trimmer.stop();
+  CHECK_FALSE(trimmer.running());
+}
@@ -0,0 +1,88 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "hugepages.h"
+#include "memorystorm.h"
+
+using namespace memorystorm;
+
+TEST_CASE("huge_buffer: aligned, zeroed and movable", "[hugepages]") {
+  size_t constexpr size{3 * 1024 * 1024};
+  huge_buffer buffer{size};
+  REQUIRE(buffer);
+  CHECK(buffer.size() == size);
+  #if !defined(_WIN32)
+    CHECK(reinterpret_cast<uintptr_t>(buffer.data()) % (2 * 1024 * 1024) == 0); // Windows only aligns large page buffers
+  #endif // !defined(_WIN32)
+  auto const *const bytes{static_cast<unsigned char const*>(buffer.data())};
+  CHECK(bytes[0] == 0);
+  CHECK(bytes[size - 1] == 0);
+  std::memset(buffer.data(), 1, size);
+
+  void *const data{buffer.data()};
+  huge_buffer moved{std::move(buffer)};
+  CHECK_FALSE(buffer);
+  CHECK(buffer.size() == 0);
+  CHECK(moved.data() == data);
+  CHECK(moved.get_huge_page_bytes() <= 4 * 1024 * 1024);
+  CHECK(huge_buffer{}.get_huge_page_bytes() == 0);
+}
+
+TEST_CASE("huge_buffer: explicit huge pages fall back when the pool is empty", "[hugepages]") {
+  huge_buffer buffer{4 * 1024 * 1024, huge_page_kind::explicit_2mb, true};
+  REQUIRE(buffer);
+  if(buffer.explicit_huge_pages()) {
+    CHECK(buffer.get_huge_page_bytes() == 4 * 1024 * 1024);
+  } else {
+    CHECK(static_cast<unsigned char const*>(buffer.data())[4 * 1024 * 1024 - 1] == 0);
+  }
+}
+
+#if defined(__linux__)
+TEST_CASE("huge_buffer: a 1GB fallback is sized and populated for transparent pages", "[hugepages]") {
+  size_t constexpr size{4 * 1024 * 1024};
+  uint64_t const virtual_before{get_virtual_usage()};
+  uint64_t const physical_before{get_physical_usage()};
+  huge_buffer buffer{size, huge_page_kind::explicit_1gb, true};
+  REQUIRE(buffer);
+  if(buffer.explicit_huge_pages()) {
+    SUCCEED("the 1GB pool had a free page");
+    return;
+  }
+  CHECK(reinterpret_cast<uintptr_t>(buffer.data()) % (2 * 1024 * 1024) == 0);
+  CHECK(get_virtual_usage() - virtual_before < 64 * 1024 * 1024);
+  CHECK(get_physical_usage() - physical_before < 64 * 1024 * 1024);
+}
+
+TEST_CASE("get_huge_page_status: reads the THP settings and pools", "[hugepages]") {
+  auto const status{get_huge_page_status()};
+  if(status.mode == thp_mode::unavailable) {
+    SUCCEED("transparent huge pages are unavailable here");
+    return;
+  }
+  CHECK(status.defrag != thp_defrag::unavailable);
+  CHECK(status.thp_size >= 2 * 1024 * 1024);
+  CHECK(status.process_anon_huge_bytes <= status.anon_huge_bytes + status.thp_size);
+  for(size_t i{0}; i != status.pools.size(); ++i) {
+    CHECK(status.pools[i].free <= status.pools[i].total);
+    if(i != 0) {
+      CHECK(status.pools[i - 1].page_size < status.pools[i].page_size);
+    }
+  }
+}
+
+TEST_CASE("huge_buffer: touched memory is backed by transparent huge pages when enabled", "[hugepages]") {
+  auto const status{get_huge_page_status()};
+  if(status.mode == thp_mode::unavailable || status.mode == thp_mode::never) {
+    SUCCEED("transparent huge pages are disabled here");
+    return;
+  }
+  huge_buffer buffer{16 * 1024 * 1024, huge_page_kind::transparent, true};
+  REQUIRE(buffer);
+  auto const huge{buffer.get_huge_page_bytes()};
+  CHECK(huge <= 16 * 1024 * 1024);
+  CHECK(huge % status.thp_size == 0);
+}
+#endif
@@ -1,7 +1,22 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
+#if !defined(_WIN32)
+  #include <pthread.h>
+#endif
+#if defined(__linux__)
+  #include <dirent.h>
+  #include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "memorystorm.h"
 
@@ -94,6 +109,83 @@ TEST_CASE("get_stack_available: returns a positive non-zero value", "[memory][st
   CHECK(available > 0);
 }
 
+namespace {
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define TEST_NOINLINE __attribute__((noinline))
+#else
+  #define TEST_NOINLINE
+#endif
+
+TEST_NOINLINE uint64_t stack_available_at_depth(unsigned int depth) {
+  char volatile padding[256]{};
+  if(depth == 0) {
+    return get_stack_available() + padding[0];
+  }
+  return stack_available_at_depth(depth - 1) + padding[0];
+}
+
+TEST_NOINLINE unsigned int recurse_until_guarded(stack_guard const &guard, unsigned int depth) {
+  char volatile padding[1024]{};
+  if(!guard || depth == 1'000'000) {
+    return depth + padding[0];
+  }
+  return recurse_until_guarded(guard, depth + 1) + padding[0];
+}
+
+#if !defined(_WIN32)
+template<typename Function>
+void run_on_thread_with_stack(size_t stack_size, Function function) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, stack_size);
+  pthread_t thread;
+  REQUIRE(pthread_create(&thread, &attr, [](void *argument) -> void* {
+    (*static_cast<Function*>(argument))();
+    return nullptr;
+  }, &function) == 0);
+  pthread_join(thread, nullptr);
+  pthread_attr_destroy(&attr);
+}
+#endif
+
+}
+
+TEST_CASE("get_stack_available: decreases as the stack deepens", "[memory][stack]") {
+  auto const shallow{stack_available_at_depth(0)};
+  auto const deep{stack_available_at_depth(64)};
+  CHECK(deep < shallow);
+  CHECK(shallow - deep >= 64 * 256);
+}
+
+TEST_CASE("get_stack_available: reflects a custom thread stack size", "[memory][stack][threads]") {
+#if defined(_WIN32)
+  SUCCEED("Skipped on Windows: thread stack sizes are set at creation through the Win32 API.");
+#else
+  size_t constexpr stack_size{256 * 1024};
+  uint64_t available{0};
+  run_on_thread_with_stack(stack_size, [&available]{
+    available = get_stack_available();
+  });
+  CHECK(available > 0);
+  CHECK(available < stack_size);
+#endif
+}
+
+TEST_CASE("stack_guard: stops deep recursion before the stack runs out", "[memory][stack][threads]") {
+#if defined(_WIN32)
+  SUCCEED("Skipped on Windows: thread stack sizes are set at creation through the Win32 API.");
+#else
+  unsigned int depth{0};
+  run_on_thread_with_stack(256 * 1024, [&depth]{
+    stack_guard const guard{32 * 1024};
+    depth = recurse_until_guarded(guard, 0);
+  });
+  CHECK(depth > 0);
+  CHECK(depth < 256);                                                          // each frame uses at least 1KB
+#endif
+}
+
 TEST_CASE("get_physical_total: returns a positive non-zero value", "[memory][physical]") {
   auto const total{get_physical_total()};
   CHECK(total > 0);
@@ -155,6 +247,122 @@ TEST_CASE("virtual usage is at least physical usage", "[memory][physical][virtua
 #endif
 }
 
+// ---------------------------------------------------------------------------
+// take_snapshot() – single-pass collection
+// ---------------------------------------------------------------------------
+
+TEST_CASE("take_snapshot: fills every field by default", "[memory][snapshot]") {
+  auto const current{take_snapshot()};
+  CHECK(current.stack_available > 0);
+  CHECK(current.physical_total > 0);
+  CHECK(current.physical_available <= current.physical_total);
+  CHECK(current.physical_usage > 0);
+  CHECK(current.virtual_total > 0);
+  CHECK(current.virtual_available <= current.virtual_total);
+  CHECK(current.virtual_usage > 0);
+}
+
+TEST_CASE("take_snapshot: only requested fields are filled", "[memory][snapshot]") {
+  auto const current{take_snapshot(field::physical_usage)};
+  CHECK(current.physical_usage > 0);
+  CHECK(current.stack_available == 0);
+  CHECK(current.physical_total == 0);
+  CHECK(current.virtual_total == 0);
+  CHECK(current.virtual_usage == 0);
+}
+
+TEST_CASE("take_snapshot: system totals match the individual getters", "[memory][snapshot]") {
+  auto const current{take_snapshot(field::system)};
+  CHECK(current.physical_total == get_physical_total());
+  CHECK(current.virtual_total == get_virtual_total());
+}
+
+// ---------------------------------------------------------------------------
+// get_meminfo() – /proc/meminfo breakdown
+// ---------------------------------------------------------------------------
+
+TEST_CASE("get_meminfo: core fields are consistent on Linux", "[memory][meminfo]") {
+#if defined(__linux__)
+  auto const info{get_meminfo()};
+  CHECK(info.mem_total > 0);
+  CHECK(info.mem_free <= info.mem_total);
+  CHECK(info.mem_available <= info.mem_total);
+  CHECK(info.huge_page_size > 0);
+  CHECK(info.huge_pages_free <= info.huge_pages_total);
+  CHECK(info.commit_limit > 0);
+#else
+  SUCCEED("Skipped: /proc/meminfo is only available on Linux.");
+#endif
+}
+
+TEST_CASE("get_meminfo: only requested fields are filled", "[memory][meminfo]") {
+  auto const info{get_meminfo(meminfo_field::cached)};
+  CHECK(info.mem_total == 0);
+  CHECK(info.mem_available == 0);
+  CHECK(info.huge_page_size == 0);
+}
+
+TEST_CASE("get_physical_available: reclaimable mode reports at least free memory", "[memory][physical][meminfo]") {
+#if defined(__linux__)
+  CHECK(get_physical_available(available_mode::reclaimable) <= get_physical_total());
+  CHECK(get_physical_available(available_mode::reclaimable) > 0);
+#else
+  CHECK(get_physical_available(available_mode::reclaimable) == get_physical_available());
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Process usage fast path – thread safety and latency
+// ---------------------------------------------------------------------------
+
+TEST_CASE("get_physical_usage: safe to call concurrently from many threads", "[memory][physical][threads]") {
+  std::atomic<unsigned int> failures{0};
+  std::vector<std::thread> threads;
+  for(unsigned int i{0}; i != 8; ++i) {
+    threads.emplace_back([&failures]{
+      for(unsigned int j{0}; j != 1'000; ++j) {
+        if(get_physical_usage() == 0 || get_virtual_usage() == 0) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for(auto &thread : threads) {
+    thread.join();
+  }
+  CHECK(failures == 0);
+}
+
+#if defined(__linux__)
+TEST_CASE("get_physical_usage: keeps one statm descriptor open", "[memory][physical]") {
+  // Timing lives in memorystorm_bench; here the test checks the behaviour that
+  // makes the call cheap: one descriptor, opened once and reused.
+  auto const statm_descriptors{[]{
+    std::vector<int> result;
+    DIR *const directory{opendir("/proc/self/fd")};
+    REQUIRE(directory != nullptr);
+    while(dirent const *entry{readdir(directory)}) {
+      std::string const link{std::string{"/proc/self/fd/"} + entry->d_name};
+      char target[256];
+      ssize_t const length{readlink(link.c_str(), target, sizeof(target) - 1)};
+      std::string_view const path{target, length > 0 ? static_cast<size_t>(length) : 0};
+      if(path.size() >= 6 && path.substr(path.size() - 6) == "/statm") {
+        result.emplace_back(std::atoi(entry->d_name));
+      }
+    }
+    closedir(directory);
+    return result;
+  }};
+  CHECK(get_physical_usage() > 0);
+  auto const opened{statm_descriptors()};
+  REQUIRE(opened.size() == 1);
+  for(unsigned int i{0}; i != 1'000; ++i) {
+    get_physical_usage();
+  }
+  CHECK(statm_descriptors() == opened);                                         // the same descriptor, not closed and reopened
+}
+#endif
+
 // ---------------------------------------------------------------------------
 // Memory values are sensible magnitudes (1 MB .. 1 TB range for a CI host)
 // ---------------------------------------------------------------------------
@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "memorystorm.h"
+#include "numa.h"
+
+using namespace memorystorm;
+
+#if defined(__linux__)
+TEST_CASE("parse_node_meminfo: reads node meminfo fields in bytes", "[numa]") {
+  numa_node_memory memory{};
+  detail::parse_node_meminfo("Node 1 MemTotal:       16384 kB\n"
+                             "Node 1 MemFree:         4096 kB\n"
+                             "Node 1 MemUsed:        12288 kB\n"
+                             "Node 1 Active(file):     100 kB\n"
+                             "Node 1 Inactive(file):   200 kB\n"
+                             "Node 1 FilePages:        300 kB\n"
+                             "Node 1 AnonPages:        400 kB\n"
+                             "Node 1 Shmem:             50 kB\n"
+                             "Node 1 KReclaimable:      70 kB\n"
+                             "Node 1 SReclaimable:      60 kB\n"
+                             "Node 1 HugePages_Total:     0", memory);
+  CHECK(memory.total            == 16384 * 1024);
+  CHECK(memory.free             ==  4096 * 1024);
+  CHECK(memory.used             == 12288 * 1024);
+  CHECK(memory.active_file      ==   100 * 1024);
+  CHECK(memory.inactive_file    ==   200 * 1024);
+  CHECK(memory.file_pages       ==   300 * 1024);
+  CHECK(memory.anon_pages       ==   400 * 1024);
+  CHECK(memory.shmem            ==    50 * 1024);
+  CHECK(memory.slab_reclaimable ==    60 * 1024);
+}
+
+TEST_CASE("add_numa_maps_line: splits pages by node, kind and page size", "[numa]") {
+  std::vector<numa_process_memory> nodes;
+  detail::add_numa_maps_line("7f0000000000 default anon=3 dirty=3 N0=1 N1=2 kernelpagesize_kB=4", 4096, nodes);
+  detail::add_numa_maps_line("55d000000000 default file=/usr/bin/app mapped=4 N1=4 kernelpagesize_kB=4", 4096, nodes);
+  detail::add_numa_maps_line("7f4000000000 default file=/anon_hugepage\\040(deleted) huge anon=1 dirty=1 N0=1 kernelpagesize_kB=2048", 4096, nodes);
+  detail::add_numa_maps_line("7ffd00000000 default stack anon=2 dirty=2 N0=2 kernelpagesize_kB=4", 4096, nodes);
+  REQUIRE(nodes.size() == 2);
+  CHECK(nodes[0].node == 0);
+  CHECK(nodes[0].bytes      == 3 * 4096 + 2048 * 1024);
+  CHECK(nodes[0].anon_bytes == 3 * 4096 + 2048 * 1024);
+  CHECK(nodes[0].file_bytes == 0);
+  CHECK(nodes[0].huge_bytes == 2048 * 1024);
+  CHECK(nodes[1].node == 1);
+  CHECK(nodes[1].bytes      == 6 * 4096);
+  CHECK(nodes[1].anon_bytes == 2 * 4096);
+  CHECK(nodes[1].file_bytes == 4 * 4096);
+  CHECK(nodes[1].huge_bytes == 0);
+}
+
+TEST_CASE("add_numa_maps_line: keeps every node of a large machine", "[numa]") {
+  std::string line{"7f0000000000 interleave:0-99 anon=100"};
+  for(unsigned int node{0}; node != 100; ++node) {
+    line += " N" + std::to_string(node) + "=1";
+  }
+  line += " kernelpagesize_kB=4";
+  std::vector<numa_process_memory> nodes;
+  detail::add_numa_maps_line(line, 4096, nodes);
+  REQUIRE(nodes.size() == 100);
+  CHECK(nodes.back().node == 99);
+  CHECK(nodes.back().anon_bytes == 4096);
+}
+
+TEST_CASE("get_numa_meminfo: one entry per online node", "[numa]") {
+  auto const nodes{get_numa_nodes()};
+  auto const meminfo{get_numa_meminfo()};
+  REQUIRE(meminfo.size() == nodes.size());
+  uint64_t total{0};
+  for(size_t i{0}; i != nodes.size(); ++i) {
+    CHECK(meminfo[i].node == nodes[i]);
+    CHECK(meminfo[i].total > 0);
+    CHECK(meminfo[i].free <= meminfo[i].total);
+    total += meminfo[i].total;
+  }
+  if(!nodes.empty()) {
+    CHECK(total <= get_physical_total() + 64 * 1024 * 1024);
+  }
+}
+
+TEST_CASE("get_process_numa_memory: a touched buffer is counted as anonymous memory", "[numa]") {
+  if(get_numa_nodes().empty()) {
+    SUCCEED("NUMA is unavailable here");
+    return;
+  }
+  std::vector<char> buffer(32 * 1024 * 1024);
+  std::memset(buffer.data(), 1, buffer.size());
+  auto const nodes{get_process_numa_memory()};
+  REQUIRE(!nodes.empty());
+  uint64_t bytes{0};
+  uint64_t anon{0};
+  for(auto const &node : nodes) {
+    CHECK(node.anon_bytes + node.file_bytes <= node.bytes);
+    bytes += node.bytes;
+    anon += node.anon_bytes;
+  }
+  CHECK(anon >= buffer.size());
+  CHECK(bytes >= anon);
+  CHECK(std::is_sorted(nodes.begin(), nodes.end(), [](auto const &a, auto const &b){return a.node < b.node;}));
+}
+
+TEST_CASE("get_page_nodes: touched pages are on an online node", "[numa]") {
+  auto const nodes{get_numa_nodes()};
+  if(nodes.empty()) {
+    SUCCEED("NUMA is unavailable here");
+    return;
+  }
+  std::vector<char> buffer(256 * 1024);
+  std::memset(buffer.data(), 1, buffer.size());
+  auto const pages{get_page_nodes(buffer.data(), buffer.size())};
+  REQUIRE(pages.size() >= buffer.size() / 4096);
+  for(int32_t const node : pages) {
+    if(node != numa_page_absent) {
+      CHECK(std::find(nodes.begin(), nodes.end(), static_cast<uint32_t>(node)) != nodes.end());
+    }
+  }
+  CHECK(std::count(pages.begin(), pages.end(), numa_page_absent) == 0);
+  CHECK(get_page_nodes(buffer.data(), 0).empty());
+}
+#endif
@@ -0,0 +1,102 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "memorystorm.h"
+#include "peak.h"
+
+using namespace memorystorm;
+using namespace std::chrono_literals;
+
+// ---------------------------------------------------------------------------
+// peak_scope and peak_histogram – this executable doesn't link the allocation hooks
+// ---------------------------------------------------------------------------
+
+namespace {
+
+uint64_t constexpr spike_size{64 * 1024 * 1024};
+
+void spike(uint64_t size, std::chrono::milliseconds hold = 0ms) {
+  /// Touch and release a block large enough for malloc to map and unmap it directly
+  void *const block{std::malloc(size)};
+  REQUIRE(block != nullptr);
+  std::memset(block, 1, size);
+  std::this_thread::sleep_for(hold);
+  std::free(block);
+}
+
+}
+
+TEST_CASE("peak_histogram: buckets, percentiles and mean", "[peak]") {
+  peak_histogram histogram;
+  CHECK(histogram.get_percentile(50.0) == 0);
+  histogram.record(0);
+  histogram.record(1'000);
+  histogram.record(1'000);
+  histogram.record(1'000'000);
+  CHECK(histogram.get_count() == 4);
+  CHECK(histogram.get_max() == 1'000'000);
+  CHECK(histogram.get_mean() == 250'500.0);
+  auto const buckets{histogram.get_buckets()};
+  CHECK(buckets[0] == 1);
+  CHECK(buckets[10] == 2);                                                      // [512, 1024)
+  CHECK(histogram.get_percentile(50.0) == 1'023);
+  CHECK(histogram.get_percentile(100.0) == 1'000'000);
+  histogram.reset();
+  CHECK(histogram.get_count() == 0);
+}
+
+#if defined(__linux__)
+TEST_CASE("peak_scope: high water mark catches a released spike", "[peak]") {
+  if(get_default_peak_method() != peak_method::high_water_mark) {
+    SUCCEED("/proc/self/clear_refs isn't writable here");
+    return;
+  }
+  peak_histogram histogram;
+  peak_scope scope{&histogram};
+  CHECK(scope.get_method() == peak_method::high_water_mark);
+  spike(spike_size);
+  auto const usage{scope.finish()};
+  CHECK(usage.increase() >= spike_size * 9 / 10);
+  CHECK(get_physical_usage() < usage.peak);
+  CHECK(histogram.get_count() == 1);
+  CHECK(scope.finish().peak == usage.peak);                                     // finishing twice returns the same figures
+  CHECK(histogram.get_count() == 1);
+}
+
+TEST_CASE("peak_scope: nested scopes keep their own peaks across resets", "[peak]") {
+  if(get_default_peak_method() != peak_method::high_water_mark) {
+    SUCCEED("/proc/self/clear_refs isn't writable here");                       // sampling would miss the unheld spikes
+    return;
+  }
+  peak_scope outer;
+  spike(spike_size);
+  uint64_t inner_increase{0};
+  {
+    peak_scope inner;                                                           // resets VmHWM, after folding it into outer
+    spike(spike_size / 2);
+    inner_increase = inner.current().increase();
+  }
+  CHECK(inner_increase >= spike_size / 2 * 9 / 10);
+  CHECK(inner_increase < spike_size * 9 / 10);
+  CHECK(outer.current().increase() >= spike_size * 9 / 10);
+}
+#endif
+
+TEST_CASE("peak_scope: sampling catches a held spike", "[peak]") {
+  set_peak_sampling_interval(1ms);
+  peak_scope scope{nullptr, peak_method::sampling};
+  CHECK(scope.get_method() == peak_method::sampling);
+  spike(spike_size, 50ms);
+  auto const usage{scope.finish()};
+  CHECK(usage.increase() >= spike_size * 9 / 10);
+  CHECK(usage.duration >= 50ms);
+  set_peak_sampling_interval(10ms);
+}
+
+TEST_CASE("peak_scope: alloc_hooks falls back to sampling without the hooks", "[peak]") {
+  peak_scope scope{nullptr, peak_method::alloc_hooks};
+  CHECK(scope.get_method() == peak_method::sampling);
+}
@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "pressure.h"
+
+#if defined(__linux__)
+  #include <unistd.h>
+#endif
+
+using namespace memorystorm;
+using namespace std::chrono_literals;
+
+// ---------------------------------------------------------------------------
+// Memory pressure stall information
+// ---------------------------------------------------------------------------
+
+TEST_CASE("get_memory_pressure: averages are valid percentages", "[pressure]") {
+  auto const stats{get_memory_pressure()};
+  for(auto const &line : {stats.some, stats.full}) {
+    CHECK(line.avg10  >= 0.0);
+    CHECK(line.avg10  <= 100.0);
+    CHECK(line.avg60  >= 0.0);
+    CHECK(line.avg60  <= 100.0);
+    CHECK(line.avg300 >= 0.0);
+    CHECK(line.avg300 <= 100.0);
+  }
+  CHECK(stats.full.total <= stats.some.total);                                 // full stalls are a subset of some stalls
+}
+
+#if defined(__linux__)
+TEST_CASE("get_memory_pressure: parses canned some and full lines", "[pressure]") {
+  char path[]{"/tmp/memorystorm_pressure_XXXXXX"};
+  close(mkstemp(path));
+  std::ofstream{path} << "some avg10=1.50 avg60=0.25 avg300=12.04 total=123456\n"
+                         "full avg10=0.00 avg60=0.10 avg300=100.00 total=789\n";
+  auto const stats{get_memory_pressure(path)};
+  unlink(path);
+  CHECK(stats.some.avg10 > 1.49);
+  CHECK(stats.some.avg10 < 1.51);
+  CHECK(stats.some.avg60 > 0.24);
+  CHECK(stats.some.avg60 < 0.26);
+  CHECK(stats.some.avg300 > 12.03);
+  CHECK(stats.some.avg300 < 12.05);
+  CHECK(stats.some.total == 123456us);
+  CHECK(stats.full.avg10 == 0.0);
+  CHECK(stats.full.avg300 > 99.99);
+  CHECK(stats.full.total == 789us);
+}
+#endif
+
+TEST_CASE("get_memory_pressure: missing file reports zero", "[pressure]") {
+  auto const stats{get_memory_pressure("/nonexistent/memory.pressure")};
+  CHECK(stats.some.total == 0us);
+  CHECK(stats.full.avg300 == 0.0);
+}
+
+TEST_CASE("pressure_monitor: cannot start without triggers", "[pressure]") {
+  pressure_monitor monitor;
+  CHECK_FALSE(monitor.start());
+  CHECK_FALSE(monitor.running());
+}
+
+TEST_CASE("pressure_monitor: starts and stops promptly when a trigger is registered", "[pressure]") {
+  pressure_monitor monitor;
+  if(!monitor.add_trigger(pressure_kind::some, 150ms, 2s, [](pressure_kind, std::chrono::microseconds, std::chrono::microseconds){})) {
+    SUCCEED("PSI triggers are unavailable or not permitted here");
+    return;
+  }
+  REQUIRE(monitor.start());
+  CHECK(monitor.running());
+  CHECK_FALSE(monitor.add_trigger(pressure_kind::full, 150ms, 2s, nullptr));    // only while stopped
+  auto const start{std::chrono::steady_clock::now()};
+  monitor.stop();
+  CHECK(std::chrono::steady_clock::now() - start < 1s);
+  CHECK_FALSE(monitor.running());
+}
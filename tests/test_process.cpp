@@ -0,0 +1,100 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "memorystorm.h"
+#include "process.h"
+
+#if defined(__linux__)
+  #include <csignal>
+  #include <sys/wait.h>
+  #include <unistd.h>
+#endif
+
+using namespace memorystorm;
+
+#if defined(__linux__)
+namespace {
+
+struct child_processes {
+  /// Forks children that sleep until killed
+  std::vector<pid_t> pids;
+
+  explicit child_processes(unsigned int count) {
+    for(unsigned int i{0}; i != count; ++i) {
+      pid_t const pid{fork()};
+      if(pid == 0) {
+        pause();
+        _exit(0);
+      }
+      pids.emplace_back(pid);
+    }
+  }
+  ~child_processes() {
+    for(pid_t const pid : pids) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+  }
+};
+
+}
+
+TEST_CASE("get_process_memory: this process matches get_physical_usage", "[process]") {
+  auto const self{get_process_memory(get_current_process_id(), process_field::all)};
+  REQUIRE(self.valid);
+  CHECK(self.pid == get_current_process_id());
+  CHECK(self.rss > 0);
+  CHECK(self.vsz >= self.rss);
+  CHECK(self.pss > 0);
+  CHECK(self.pss <= self.rss + 1024 * 1024);                                    // read at slightly different times
+  uint64_t const usage{get_physical_usage()};
+  CHECK(self.rss > usage / 2);
+  CHECK(self.rss < usage * 2);
+}
+
+TEST_CASE("get_process_memory: invalid for a process that doesn't exist", "[process]") {
+  auto const missing{get_process_memory(0x7ffffff0u)};
+  CHECK_FALSE(missing.valid);
+  CHECK(missing.rss == 0);
+}
+
+TEST_CASE("get_process_tree: includes forked children", "[process]") {
+  child_processes children{3};
+  auto const tree{get_process_tree()};
+  REQUIRE(!tree.empty());
+  CHECK(tree.front() == get_current_process_id());
+  for(pid_t const pid : children.pids) {
+    CHECK(std::find(tree.begin(), tree.end(), static_cast<uint32_t>(pid)) != tree.end());
+  }
+  CHECK(get_process_tree(0x7ffffff0u).empty());
+}
+
+TEST_CASE("get_process_tree_memory: totals add up", "[process]") {
+  child_processes children{2};
+  auto const group{get_process_tree_memory(get_current_process_id(), process_field::all)};
+  REQUIRE(group.processes.size() >= 3);
+  REQUIRE(group.total.valid);
+  uint64_t rss{0};
+  uint64_t pss{0};
+  for(auto const &process : group.processes) {
+    rss += process.rss;
+    pss += process.pss;
+  }
+  CHECK(group.total.rss == rss);
+  CHECK(group.total.pss == pss);
+  CHECK(group.total.pss <= group.total.rss);                                    // forked children share pages
+}
+
+TEST_CASE("get_top_processes: sorted, limited and skips missing processes", "[process]") {
+  child_processes children{3};
+  std::vector<uint32_t> pids{get_current_process_id(), 0x7ffffff0u};
+  for(pid_t const pid : children.pids) {
+    pids.emplace_back(static_cast<uint32_t>(pid));
+  }
+  auto const top{get_top_processes(pids, 2)};
+  REQUIRE(top.size() == 2);
+  CHECK(top[0].rss >= top[1].rss);
+  CHECK(get_top_processes(pids, 100).size() == 4);
+}
+#endif
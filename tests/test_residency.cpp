@@ -0,0 +1,106 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "residency.h"
+
+#if defined(__linux__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+using namespace memorystorm;
+
+TEST_CASE("get_residency: empty range", "[residency]") {
+  auto const result{get_residency(nullptr, 0, residency_field::all)};
+  CHECK(result.pages == 0);
+  CHECK(result.resident_pages == 0);
+  CHECK(result.resident_fraction() == 0.0);
+}
+
+#if defined(__linux__)
+namespace {
+
+struct anonymous_mapping {
+  size_t const size;
+  char *const memory;
+
+  explicit anonymous_mapping(size_t this_size)
+    : size{this_size},
+      memory{static_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))} {
+  }
+  ~anonymous_mapping() {
+    munmap(memory, size);
+  }
+};
+
+}
+
+TEST_CASE("get_residency: counts touched pages exactly", "[residency]") {
+  size_t const page_size{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+  anonymous_mapping mapping{page_size * 64};
+  REQUIRE(mapping.memory != MAP_FAILED);
+  CHECK(get_residency(mapping.memory, mapping.size).resident_pages == 0);
+  for(size_t page{0}; page < 64; page += 2) {
+    mapping.memory[page * page_size] = 1;
+  }
+  auto const result{get_residency(mapping.memory, mapping.size, residency_field::bitmap)};
+  CHECK(result.page_size == page_size);
+  CHECK(result.pages == 64);
+  CHECK(result.resident_pages == 32);
+  CHECK(result.resident_fraction() == 0.5);
+  REQUIRE(result.bitmap.size() == 8);
+  CHECK(result.is_resident(0));
+  CHECK_FALSE(result.is_resident(1));
+  CHECK(result.is_resident(62));
+  CHECK_FALSE(result.is_resident(63));
+  CHECK_FALSE(result.is_resident(64));
+}
+
+TEST_CASE("get_residency: rounds partial pages out", "[residency]") {
+  size_t const page_size{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+  anonymous_mapping mapping{page_size * 4};
+  REQUIRE(mapping.memory != MAP_FAILED);
+  CHECK(get_residency(mapping.memory + page_size - 1, 2).pages == 2);
+  CHECK(get_residency(mapping.memory + 1, 1).pages == 1);
+}
+
+TEST_CASE("get_residency: batch matches individual queries", "[residency]") {
+  size_t const page_size{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+  anonymous_mapping first{page_size * 16};
+  anonymous_mapping second{page_size * 16};
+  REQUIRE(first.memory != MAP_FAILED);
+  REQUIRE(second.memory != MAP_FAILED);
+  std::memset(first.memory, 1, first.size);
+  std::memset(second.memory, 1, page_size * 4);
+  auto const batch{get_residency({{first.memory, first.size}, {second.memory, second.size}}, residency_field::all)};
+  REQUIRE(batch.size() == 2);
+  CHECK(batch[0].resident_pages == 16);
+  CHECK(batch[1].resident_pages == 4);
+  CHECK(batch[1].resident_pages == get_residency(second.memory, second.size).resident_pages);
+  CHECK(batch[0].swapped_pages == 0);
+  CHECK(batch[0].file_pages == 0);                                              // private anonymous memory
+}
+
+TEST_CASE("prefetch: brings a mapped file in", "[residency]") {
+  size_t constexpr size{4 * 1024 * 1024};
+  char path[]{"/tmp/memorystorm_residency_XXXXXX"};
+  int const fd{mkstemp(path)};
+  REQUIRE(fd >= 0);
+  unlink(path);
+  std::vector<char> data(size, 'x');
+  REQUIRE(write(fd, data.data(), size) == static_cast<ssize_t>(size));
+  fsync(fd);
+  posix_fadvise(fd, 0, size, POSIX_FADV_DONTNEED);                              // try to evict it; a tmpfs /tmp keeps it resident regardless
+  CHECK(prefetch_file(fd, 0, size));
+  void *const memory{mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)};
+  REQUIRE(memory != MAP_FAILED);
+  CHECK(prefetch(memory, size, 1.0, std::chrono::milliseconds{5000}) == 1.0);
+  auto const result{get_residency(memory, size, residency_field::pagemap)};
+  CHECK(result.resident_pages == result.pages);
+  munmap(memory, size);
+  close(fd);
+}
+#endif
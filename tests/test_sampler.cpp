@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <thread>
+
+#include "sampler.h"
+
+using namespace memorystorm;
+using namespace std::chrono_literals;
+
+// ---------------------------------------------------------------------------
+// sampler – background sampling and lock-free reads
+// ---------------------------------------------------------------------------
+
+TEST_CASE("sampler: latest is zeroed before start", "[sampler]") {
+  sampler background{10ms};
+  CHECK_FALSE(background.running());
+  CHECK(background.sample_count() == 0);
+  CHECK(background.latest().memory.physical_usage == 0);
+}
+
+TEST_CASE("sampler: start publishes a sample immediately", "[sampler]") {
+  sampler background{1s};
+  background.start();
+  CHECK(background.running());
+  CHECK(background.sample_count() >= 1);
+  auto const latest{background.latest()};
+  CHECK(latest.memory.physical_usage > 0);
+  CHECK(latest.memory.physical_total > 0);
+  CHECK(latest.memory.stack_available == 0);                                    // not sampled by default
+  background.stop();
+  CHECK_FALSE(background.running());
+}
+
+TEST_CASE("sampler: samples accumulate and history is newest first", "[sampler]") {
+  sampler background{1ms, field::process};
+  background.start();
+  while(background.sample_count() < 5) {
+    std::this_thread::sleep_for(1ms);
+  }
+  background.stop();
+  sample recent[4];
+  auto const copied{background.history(recent, 4)};
+  REQUIRE(copied == 4);
+  for(size_t i{1}; i != copied; ++i) {
+    CHECK(recent[i - 1].time >= recent[i].time);
+  }
+  CHECK(recent[0].memory.physical_usage > 0);
+  CHECK(recent[0].memory.physical_total == 0);                                 // not requested
+}
+
+TEST_CASE("sampler: history is bounded by capacity", "[sampler]") {
+  sampler background{100us, field::physical_usage};
+  background.start();
+  while(background.sample_count() < sampler::capacity + 10) {
+    std::this_thread::sleep_for(1ms);
+  }
+  background.stop();
+  sample recent[sampler::capacity + 10];
+  CHECK(background.history(recent, sampler::capacity + 10) == sampler::capacity);
+}
+
+TEST_CASE("sampler: interval can be changed while running", "[sampler]") {
+  sampler background{1h};
+  background.start();
+  auto const initial{background.sample_count()};
+  background.set_interval(1ms);
+  CHECK(background.get_interval() == 1ms);
+  auto const deadline{std::chrono::steady_clock::now() + 5s};
+  while(background.sample_count() < initial + 3 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  CHECK(background.sample_count() >= initial + 3);
+}
+
+TEST_CASE("sampler: stop is prompt even with a long interval, and restart works", "[sampler]") {
+  sampler background{1h};
+  background.start();
+  auto const start{std::chrono::steady_clock::now()};
+  background.stop();
+  CHECK(std::chrono::steady_clock::now() - start < 1s);
+  background.start();
+  CHECK(background.running());
+  CHECK(background.sample_count() == 2);
+}
@@ -0,0 +1,116 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "smaps.h"
+
+#if defined(__linux__)
+  #include <sys/mman.h>
+  #include "procfs.h"
+#endif
+
+using namespace memorystorm;
+
+// ---------------------------------------------------------------------------
+// smaps_rollup – process-wide breakdown
+// ---------------------------------------------------------------------------
+
+TEST_CASE("get_smaps_rollup: totals are consistent", "[smaps]") {
+  auto const rollup{get_smaps_rollup()};
+#if defined(__linux__)
+  CHECK(rollup.rss > 0);
+  CHECK(rollup.pss > 0);
+  CHECK(rollup.pss <= rollup.rss);
+  CHECK(rollup.private_clean + rollup.private_dirty + rollup.shared_clean + rollup.shared_dirty == rollup.rss);
+  CHECK(rollup.anonymous <= rollup.rss);
+  CHECK(rollup.rss % 1024 == 0);
+#else
+  CHECK(rollup.rss == 0);
+#endif
+}
+
+#if defined(__linux__)
+TEST_CASE("get_smaps_rollup: sees anonymous memory being touched", "[smaps]") {
+  size_t constexpr size{32 * 1024 * 1024};
+  auto const before{get_smaps_rollup()};
+  void *const memory{mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  REQUIRE(memory != MAP_FAILED);
+  std::memset(memory, 1, size);
+  auto const after{get_smaps_rollup()};
+  munmap(memory, size);
+  CHECK(after.anonymous >= before.anonymous + size / 2);                        // allow for other memory being released meanwhile
+}
+
+// ---------------------------------------------------------------------------
+// Top mappings – full smaps walk
+// ---------------------------------------------------------------------------
+
+TEST_CASE("get_top_mappings: sorted by rss and limited to count", "[smaps]") {
+  auto const top{get_top_mappings(5)};
+  REQUIRE(!top.empty());
+  CHECK(top.size() <= 5);
+  for(size_t i{1}; i < top.size(); ++i) {
+    CHECK(top[i - 1].memory.rss >= top[i].memory.rss);
+  }
+  for(auto const &mapping : top) {
+    CHECK(mapping.end > mapping.start);
+    CHECK(mapping.memory.rss <= mapping.size());
+    CHECK(std::strlen(mapping.permissions) == 4);
+  }
+  CHECK(get_top_mappings(0).empty());
+}
+
+TEST_CASE("get_top_mappings: finds a large touched mapping", "[smaps]") {
+  size_t constexpr size{64 * 1024 * 1024};
+  void *const memory{mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  REQUIRE(memory != MAP_FAILED);
+  std::memset(memory, 1, size);
+  auto const top{get_top_mappings(3)};
+  munmap(memory, size);
+  bool found{false};
+  for(auto const &mapping : top) {
+    if(mapping.start <= reinterpret_cast<uintptr_t>(memory) && mapping.end >= reinterpret_cast<uintptr_t>(memory) + size) {
+      found = true;
+      CHECK(std::string{mapping.permissions} == "rw-p");
+      CHECK(mapping.memory.anonymous >= size);
+    }
+  }
+  CHECK(found);
+}
+
+TEST_CASE("get_top_mappings: agrees with the rollup", "[smaps]") {
+  auto const all{get_top_mappings(100'000)};
+  auto const rollup{get_smaps_rollup()};
+  uint64_t rss{0};
+  for(auto const &mapping : all) {
+    rss += mapping.memory.rss;
+  }
+  CHECK(rss > rollup.rss / 2);                                                  // read at different times, so only roughly equal
+  CHECK(rss < rollup.rss * 2);
+}
+
+// ---------------------------------------------------------------------------
+// Streaming line reader
+// ---------------------------------------------------------------------------
+
+TEST_CASE("procfs::for_each_line: handles lines split across reads and overlong lines", "[smaps][procfs]") {
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  std::string const input{"short\n" + std::string(100, 'x') + "\nmiddle line\nlast"};
+  REQUIRE(write(fds[1], input.data(), input.size()) == static_cast<ssize_t>(input.size()));
+  close(fds[1]);
+  char buffer[16];
+  std::vector<std::string> lines;
+  procfs::for_each_line(fds[0], buffer, sizeof(buffer), [&](std::string_view line){
+    lines.emplace_back(line);
+  });
+  close(fds[0]);
+  REQUIRE(lines.size() == 4);
+  CHECK(lines[0] == "short");
+  CHECK(lines[1] == std::string(16, 'x'));
+  CHECK(lines[2] == "middle line");
+  CHECK(lines[3] == "last");
+}
+#endif
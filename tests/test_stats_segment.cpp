@@ -0,0 +1,121 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "stats_segment.h"
+
+#if defined(__linux__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <sys/wait.h>
+  #include <unistd.h>
+#endif
+
+using namespace memorystorm;
+using namespace std::chrono_literals;
+
+#if defined(__linux__)
+TEST_CASE("stats_reader: not attached when nothing is published", "[stats_segment]") {
+  stats_reader reader{static_cast<uint32_t>(getpid())};
+  CHECK_FALSE(reader.attached());
+  published_stats stats;
+  CHECK_FALSE(reader.read(stats));
+}
+
+TEST_CASE("stats_publisher: reader sees published snapshots", "[stats_segment]") {
+  stats_publisher publisher;
+  REQUIRE(publisher.open());
+  CHECK(publisher.get_name() == get_stats_segment_name(static_cast<uint32_t>(getpid())));
+  stats_reader reader{static_cast<uint32_t>(getpid())};
+  REQUIRE(reader.attached());
+  published_stats stats;
+  CHECK_FALSE(reader.read(stats));                                              // opened but nothing published yet
+
+  snapshot memory{};
+  memory.physical_usage = 12'345;
+  memory.virtual_total = 67'890;
+  publisher.publish(memory);
+  REQUIRE(reader.read(stats));
+  CHECK(stats.pid == static_cast<uint32_t>(getpid()));
+  CHECK(stats.updates == 1);
+  CHECK(stats.memory.physical_usage == 12'345);
+  CHECK(stats.memory.virtual_total == 67'890);
+  CHECK(stats.time <= std::chrono::steady_clock::now());
+}
+
+TEST_CASE("stats_publisher: background publishing", "[stats_segment]") {
+  stats_publisher publisher{5ms};
+  REQUIRE(publisher.start());
+  CHECK(publisher.running());
+  stats_reader reader{static_cast<uint32_t>(getpid())};
+  published_stats first;
+  REQUIRE(reader.read(first));
+  CHECK(first.memory.physical_total > 0);
+  published_stats later{first};
+  for(unsigned int i{0}; i != 200 && later.updates == first.updates; ++i) {
+    std::this_thread::sleep_for(5ms);
+    REQUIRE(reader.read(later));
+  }
+  CHECK(later.updates > first.updates);
+  publisher.stop();
+  CHECK_FALSE(publisher.running());
+}
+
+TEST_CASE("stats_publisher: replaces a stale segment with a fresh one it owns", "[stats_segment]") {
+  std::string const name{get_stats_segment_name(static_cast<uint32_t>(getpid()))};
+  int const stale{shm_open(name.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)};
+  REQUIRE(stale >= 0);
+  REQUIRE(ftruncate(stale, 4096) == 0);
+  stats_publisher publisher;
+  REQUIRE(publisher.open());
+  struct stat stale_status{};
+  REQUIRE(fstat(stale, &stale_status) == 0);
+  CHECK(stale_status.st_nlink == 0);                                            // unlinked, not adopted
+  close(stale);
+  int const fd{shm_open(name.c_str(), O_RDONLY, 0)};
+  REQUIRE(fd >= 0);
+  struct stat status{};
+  REQUIRE(fstat(fd, &status) == 0);
+  close(fd);
+  CHECK((status.st_mode & 0777) == 0644);
+  CHECK(status.st_uid == geteuid());
+  snapshot memory{};
+  memory.physical_usage = 1'234;
+  publisher.publish(memory);
+  stats_reader reader{static_cast<uint32_t>(getpid())};
+  published_stats stats;
+  REQUIRE(reader.read(stats));
+  CHECK(stats.memory.physical_usage == 1'234);
+}
+
+TEST_CASE("stats_publisher: segment is removed on destruction", "[stats_segment]") {
+  {
+    stats_publisher publisher;
+    REQUIRE(publisher.open());
+  }
+  stats_reader reader{static_cast<uint32_t>(getpid())};
+  CHECK_FALSE(reader.attached());
+}
+
+TEST_CASE("stats_reader: reads another process's segment", "[stats_segment]") {
+  stats_publisher publisher;
+  REQUIRE(publisher.open());
+  snapshot memory{};
+  memory.physical_usage = 424'242;
+  publisher.publish(memory);
+  uint32_t const parent{static_cast<uint32_t>(getpid())};
+  pid_t const child{fork()};
+  REQUIRE(child >= 0);
+  if(child == 0) {
+    stats_reader reader{parent};
+    published_stats stats;
+    _exit(reader.read(stats) && stats.memory.physical_usage == 424'242 ? 0 : 1);
+  }
+  int status{0};
+  REQUIRE(waitpid(child, &status, 0) == child);
+  CHECK(WIFEXITED(status));
+  CHECK(WEXITSTATUS(status) == 0);
+}
+#endif
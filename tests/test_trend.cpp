@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "trend.h"
+
+using namespace memorystorm;
+using namespace std::chrono_literals;
+
+// ---------------------------------------------------------------------------
+// trend_analyser – regression, sustained growth and exhaustion warnings
+// ---------------------------------------------------------------------------
+
+namespace {
+
+auto const start_time{std::chrono::steady_clock::time_point{} + 1h};
+
+trend_report feed(trend_analyser &trend, std::chrono::seconds duration, std::chrono::seconds step, uint64_t start, double rate, uint64_t headroom) {
+  /// Feed samples growing linearly at rate bytes per second, with headroom shrinking to match
+  trend_report report;
+  for(std::chrono::seconds t{0}; t <= duration; t += step) {
+    double const growth{rate * static_cast<double>(t.count())};
+    uint64_t const rss{start + static_cast<uint64_t>(growth)};
+    report = trend.check(start_time + t, rss, headroom - static_cast<uint64_t>(growth));
+  }
+  return report;
+}
+
+}
+
+TEST_CASE("trend_analyser: linear growth is measured in every window", "[trend]") {
+  trend_analyser trend{{10s, 60s, 300s}};
+  auto const report{feed(trend, 600s, 1s, 100'000'000, 1'000.0, 10'000'000)};
+  REQUIRE(report.windows.size() == 3);
+  for(auto const &window : report.windows) {
+    CHECK(window.covered);
+    CHECK(window.rss_bytes_per_second > 990.0);
+    CHECK(window.rss_bytes_per_second < 1'010.0);
+  }
+  CHECK(report.sustained_growth);
+  CHECK(report.bytes_per_second > 990.0);
+  CHECK(report.time_to_exhaustion > 9'000s);                                   // 9.4MB left at 1KB/s
+  CHECK(report.time_to_exhaustion < 9'800s);
+}
+
+TEST_CASE("trend_analyser: flat usage and short history are not sustained growth", "[trend]") {
+  trend_analyser flat{{10s, 60s}};
+  auto const flat_report{feed(flat, 120s, 1s, 100'000'000, 0.0, 10'000'000)};
+  CHECK_FALSE(flat_report.sustained_growth);
+  CHECK(flat_report.time_to_exhaustion == std::chrono::seconds::max());
+
+  trend_analyser young{{10s, 600s}};
+  auto const young_report{feed(young, 120s, 1s, 100'000'000, 1'000.0, 10'000'000)};
+  CHECK(young_report.windows[0].covered);
+  CHECK_FALSE(young_report.windows[1].covered);
+  CHECK_FALSE(young_report.sustained_growth);
+}
+
+TEST_CASE("trend_analyser: a spike that recedes only shows in the short window", "[trend]") {
+  trend_analyser trend{{10s, 300s}};
+  feed(trend, 600s, 1s, 100'000'000, 0.0, 10'000'000);
+  trend_report report;
+  for(int t{601}; t != 631; ++t) {
+    uint64_t const rss{t < 621 ? 100'000'000 + static_cast<uint64_t>(t - 600) * 1'000'000 : 100'000'000};
+    report = trend.check(start_time + std::chrono::seconds{t}, rss, 10'000'000);
+  }
+  CHECK_FALSE(report.sustained_growth);
+  CHECK(report.windows[0].rss_bytes_per_second < 0.0);
+}
+
+TEST_CASE("trend_analyser: the warning fires once and re-arms", "[trend]") {
+  trend_analyser trend{{10s, 60s}};
+  std::vector<std::chrono::seconds> warnings;
+  trend.set_warning(1h, [&](trend_report const &report){warnings.emplace_back(report.time_to_exhaustion);});
+  feed(trend, 120s, 1s, 100'000'000, 1'000.0, 100'000'000);                   // 100MB left at 1KB/s is over a day
+  CHECK(warnings.empty());
+  trend.reset();
+  feed(trend, 120s, 1s, 100'000'000, 1'000.0, 1'000'000);
+  REQUIRE(warnings.size() == 1);
+  CHECK(warnings.front() <= 1'000s);
+  for(std::chrono::seconds t{121s}; t != 300s; t += 1s) {                       // growth stops
+    trend.check(start_time + t, 100'120'000, 880'000);
+  }
+  CHECK(trend.get_report().windows[0].rss_bytes_per_second < 1.0);
+  CHECK(trend.get_report().time_to_exhaustion > 1h);                          // older growth fades from the long window gradually
+  for(std::chrono::seconds t{300s}; t != 500s; t += 1s) {                       // and resumes
+    uint64_t const growth{static_cast<uint64_t>((t - 300s).count()) * 1'000};
+    trend.check(start_time + t, 100'120'000 + growth, 880'000 - growth);
+  }
+  CHECK(warnings.size() == 2);
+}
+
+TEST_CASE("trend_analyser: minimum growth rate filters slow growth", "[trend]") {
+  trend_analyser trend{{10s, 60s}};
+  trend.set_min_growth_rate(10'000.0);
+  CHECK_FALSE(feed(trend, 120s, 1s, 100'000'000, 1'000.0, 10'000'000).sustained_growth);
+}
+
+TEST_CASE("trend_analyser: background sampling records real usage", "[trend]") {
+  trend_analyser trend;
+  trend.start(10ms);
+  CHECK(trend.running());
+  trend.stop();
+  CHECK_FALSE(trend.running());
+  auto const report{trend.get_report()};
+  CHECK(report.rss > 0);
+  CHECK(report.windows.size() == 3);
+}
@@ -0,0 +1,169 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "memorystorm.h"
+#include "watermark.h"
+
+using namespace memorystorm;
+using namespace std::chrono_literals;
+
+// ---------------------------------------------------------------------------
+// watermarks – level transitions, hysteresis and callback ordering
+// ---------------------------------------------------------------------------
+
+namespace {
+
+void set_test_thresholds(watermarks &marks) {
+  marks.set_threshold(watermark_level::low,      watermark_threshold::bytes(1'000));
+  marks.set_threshold(watermark_level::high,     watermark_threshold::bytes(2'000));
+  marks.set_threshold(watermark_level::critical, watermark_threshold::bytes(3'000));
+}
+
+}
+
+TEST_CASE("watermarks: unset thresholds are never reached", "[watermark]") {
+  watermarks marks;
+  CHECK(marks.get_threshold(watermark_level::high) == unlimited);
+  CHECK(marks.check(UINT64_C(1) << 60) == watermark_level::normal);
+}
+
+TEST_CASE("watermarks: relative thresholds resolve against totals", "[watermark]") {
+  watermarks of_total;
+  CHECK(of_total.set_threshold(watermark_level::high, watermark_threshold::percent_of_total(50.0)));
+  CHECK(of_total.get_threshold(watermark_level::high) == get_physical_total() / 2);
+  watermarks of_limit;
+  CHECK(of_limit.set_threshold(watermark_level::critical, watermark_threshold::percent_of_limit(100.0)));
+  CHECK(of_limit.get_threshold(watermark_level::critical) <= get_physical_total());
+}
+
+TEST_CASE("watermarks: thresholds must rise with the level", "[watermark]") {
+  watermarks marks;
+  set_test_thresholds(marks);
+  CHECK_FALSE(marks.set_threshold(watermark_level::normal, watermark_threshold::bytes(500)));
+  CHECK_FALSE(marks.set_threshold(watermark_level::low, watermark_threshold::bytes(2'500)));
+  CHECK_FALSE(marks.set_threshold(watermark_level::critical, watermark_threshold::bytes(1'500)));
+  CHECK(marks.get_threshold(watermark_level::low) == 1'000);
+  CHECK(marks.get_threshold(watermark_level::critical) == 3'000);
+  CHECK(marks.set_threshold(watermark_level::high, watermark_threshold::bytes(3'000)));
+  CHECK(marks.set_threshold(watermark_level::high, watermark_threshold{}));
+  CHECK(marks.get_threshold(watermark_level::high) == unlimited);
+}
+
+TEST_CASE("watermarks: a level is reached when only higher levels are set", "[watermark]") {
+  watermarks marks{0.0};
+  int low_entries{0};
+  int critical_entries{0};
+  marks.add_callback(watermark_level::low,      [&](watermark_level, uint64_t){ ++low_entries; });
+  marks.add_callback(watermark_level::critical, [&](watermark_level, uint64_t){ ++critical_entries; });
+  CHECK(marks.set_threshold(watermark_level::critical, watermark_threshold::bytes(1'000)));
+  CHECK(marks.check(999) == watermark_level::normal);
+  CHECK(marks.check(1'000'000) == watermark_level::critical);
+  CHECK(critical_entries == 1);
+  CHECK(low_entries == 0);
+  CHECK(marks.check(10) == watermark_level::normal);
+}
+
+TEST_CASE("watermarks: rising through several levels calls back for each in order", "[watermark]") {
+  watermarks marks;
+  set_test_thresholds(marks);
+  std::vector<watermark_level> entered;
+  for(auto const level : {watermark_level::low, watermark_level::high, watermark_level::critical}) {
+    marks.add_callback(level, [&](watermark_level this_level, uint64_t){entered.emplace_back(this_level);});
+  }
+  CHECK(marks.check(500) == watermark_level::normal);
+  CHECK(entered.empty());
+  CHECK(marks.check(2'500) == watermark_level::high);
+  CHECK(entered == std::vector<watermark_level>{watermark_level::low, watermark_level::high});
+  CHECK(marks.check(3'000) == watermark_level::critical);
+  CHECK(entered.size() == 3);
+  CHECK(marks.get_level() == watermark_level::critical);
+}
+
+TEST_CASE("watermarks: hysteresis prevents flapping around a threshold", "[watermark]") {
+  watermarks marks{0.1};
+  set_test_thresholds(marks);
+  unsigned int high_entries{0};
+  marks.add_callback(watermark_level::high, [&](watermark_level, uint64_t){++high_entries;});
+  marks.check(2'000);
+  marks.check(1'950);                                                           // within 10% of the threshold, stays high
+  marks.check(2'010);
+  CHECK(marks.get_level() == watermark_level::high);
+  CHECK(high_entries == 1);
+  CHECK(marks.check(1'700) == watermark_level::low);
+  marks.check(2'000);
+  CHECK(high_entries == 2);
+}
+
+TEST_CASE("watermarks: falling to a lower level doesn't call its callbacks again", "[watermark]") {
+  watermarks marks{0.0};
+  set_test_thresholds(marks);
+  std::vector<watermark_level> seen;
+  for(auto const level : {watermark_level::normal, watermark_level::low, watermark_level::high, watermark_level::critical}) {
+    marks.add_callback(level, [&](watermark_level entered, uint64_t){ seen.push_back(entered); });
+  }
+  CHECK(marks.check(3'500) == watermark_level::critical);
+  CHECK(seen.size() == 3);
+  CHECK(marks.check(2'500) == watermark_level::high);
+  CHECK(marks.check(1'500) == watermark_level::low);
+  CHECK(seen.size() == 3);
+  CHECK(marks.check(2'500) == watermark_level::high);
+  REQUIRE(seen.size() == 4);
+  CHECK(seen.back() == watermark_level::high);
+}
+
+TEST_CASE("watermarks: falling back to normal calls normal callbacks", "[watermark]") {
+  watermarks marks;
+  set_test_thresholds(marks);
+  unsigned int recovered{0};
+  marks.add_callback(watermark_level::normal, [&](watermark_level, uint64_t){++recovered;});
+  marks.check(3'500);
+  CHECK(marks.check(100) == watermark_level::normal);
+  CHECK(recovered == 1);
+}
+
+TEST_CASE("watermarks: callbacks run in priority order", "[watermark]") {
+  watermarks marks;
+  set_test_thresholds(marks);
+  std::vector<int> order;
+  marks.add_callback(watermark_level::high, [&](watermark_level, uint64_t){order.emplace_back(1);}, 1);
+  marks.add_callback(watermark_level::high, [&](watermark_level, uint64_t){order.emplace_back(10);}, 10);
+  marks.add_callback(watermark_level::high, [&](watermark_level, uint64_t){order.emplace_back(5);}, 5);
+  marks.check(2'000);
+  CHECK(order == std::vector<int>{10, 5, 1});
+}
+
+TEST_CASE("watermarks: callbacks may use the watermarks object", "[watermark]") {
+  watermarks marks;
+  set_test_thresholds(marks);
+  uint64_t seen_threshold{0};
+  unsigned int added_calls{0};
+  marks.add_callback(watermark_level::low, [&](watermark_level, uint64_t){
+    seen_threshold = marks.get_threshold(watermark_level::low);
+    marks.add_callback(watermark_level::high, [&](watermark_level, uint64_t){++added_calls;});
+    marks.set_threshold(watermark_level::critical, watermark_threshold::bytes(4'000));
+  });
+  CHECK(marks.check(1'500) == watermark_level::low);
+  CHECK(seen_threshold == 1'000);
+  CHECK(marks.get_threshold(watermark_level::critical) == 4'000);
+  CHECK(marks.check(2'500) == watermark_level::high);
+  CHECK(added_calls == 1);
+}
+
+TEST_CASE("watermarks: background checking uses process usage", "[watermark]") {
+  watermarks marks;
+  marks.set_threshold(watermark_level::low, watermark_threshold::bytes(1));    // any process exceeds one byte
+  std::atomic<bool> fired{false};
+  marks.add_callback(watermark_level::low, [&](watermark_level, uint64_t){fired = true;});
+  marks.start(1ms);
+  CHECK(marks.running());
+  auto const deadline{std::chrono::steady_clock::now() + 5s};
+  while(!fired && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(1ms);
+  }
+  marks.stop();
+  CHECK(fired);
+  CHECK_FALSE(marks.running());
+}